@@ -0,0 +1,317 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "actor-graph.h"
+#include "search-engine.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string.h>
+#include <unordered_map>
+
+using namespace std;
+
+static const char kIndexMagic[8] = {'6', 'D', 'E', 'G', 'C', 'S', 'R', '2'};
+static const uint32_t kNone = UINT32_MAX;
+
+/**
+ * Type: indexHeader
+ * -----------------
+ * Leads off every sidecar index file.  The file sizes and modification times identify
+ * the data the index was built from, and the counts determine the lengths of the
+ * arrays that follow.
+ */
+struct indexHeader {
+  char magic[8];
+  uint64_t actorFileSize;
+  uint64_t movieFileSize;
+  uint64_t actorFileModified;
+  uint64_t movieFileModified;
+  uint32_t numActors;
+  uint32_t numMovies;
+  uint32_t numCredits;
+  uint32_t numRoles;
+};
+
+/**
+ * Returns the number of 32-bit entries across all six arrays.
+ */
+static size_t payloadLength(size_t numActors, size_t numMovies, size_t numCredits, size_t numRoles)
+{
+  return numActors + numMovies + (numActors + 1) + numCredits + (numMovies + 1) + numRoles;
+}
+
+/**
+ * Returns true if and only if all count values are less than limit.
+ */
+static bool allBelow(const uint32_t *values, size_t count, size_t limit)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (values[i] >= limit) return false;
+  }
+  return true;
+}
+
+/**
+ * Returns true if and only if the numRows + 1 row starts of a CSR array run from 0
+ * up to numEntries without ever going down.
+ */
+static bool validStarts(const uint32_t *starts, size_t numRows, size_t numEntries)
+{
+  if (starts[0] != 0 || starts[numRows] != numEntries) return false;
+  for (size_t i = 0; i < numRows; i++)
+  {
+    if (starts[i] > starts[i + 1]) return false;
+  }
+  return true;
+}
+
+actorGraph::actorGraph() : mapped(NULL), mappedSize(0), stamp(0) {
+  reset();
+}
+
+actorGraph::~actorGraph() {
+  reset();
+}
+
+void actorGraph::reset() {
+  if (mapped != NULL) munmap(mapped, mappedSize);
+  mapped = NULL;
+  mappedSize = 0;
+  owned.clear();
+  actorFileSize = movieFileSize = 0;
+  actorFileModified = movieFileModified = 0;
+  numActors = numMovies = numCredits = numRoles = 0;
+  actorOffsets = movieOffsets = actorStart = actorMovies = movieStart = movieActors = NULL;
+}
+
+void actorGraph::build(const imdb& db) {
+  reset();
+  castRange actors = db.allActors();
+  creditRange movies = db.allMovies();
+  // ids are handed out in the imdb's own (sorted) order
+  unordered_map<uint32_t, uint32_t> actorIds, movieIds;
+  actorIds.reserve(actors.size());
+  movieIds.reserve(movies.size());
+  size_t credits = 0, roles = 0;
+  for (const castMember& actor : actors)
+  {
+    actorIds.emplace(actor.actorOffset, actorIds.size());
+    credits += db.credits(actor.actorOffset).size();
+  }
+  for (const credit& movie : movies)
+  {
+    movieIds.emplace(movie.movieOffset, movieIds.size());
+    roles += db.cast(movie.movieOffset).size();
+  }
+
+  actorFileSize = db.actorFileSize();
+  movieFileSize = db.movieFileSize();
+  actorFileModified = db.actorFileModified();
+  movieFileModified = db.movieFileModified();
+  numActors = actors.size();
+  numMovies = movies.size();
+  numCredits = credits;
+  numRoles = roles;
+  owned.reserve(payloadLength(numActors, numMovies, numCredits, numRoles));
+  for (const castMember& actor : actors) owned.push_back(actor.actorOffset);
+  for (const credit& movie : movies) owned.push_back(movie.movieOffset);
+
+  owned.push_back(0);
+  for (const castMember& actor : actors) owned.push_back(owned.back() + db.credits(actor.actorOffset).size());
+  for (const castMember& actor : actors)
+  {
+    for (const credit& movie : db.credits(actor.actorOffset)) owned.push_back(movieIds[movie.movieOffset]);
+  }
+  owned.push_back(0);
+  for (const credit& movie : movies) owned.push_back(owned.back() + db.cast(movie.movieOffset).size());
+  for (const credit& movie : movies)
+  {
+    for (const castMember& actor : db.cast(movie.movieOffset)) owned.push_back(actorIds[actor.actorOffset]);
+  }
+
+  actorOffsets = owned.data();
+  movieOffsets = actorOffsets + numActors;
+  actorStart = movieOffsets + numMovies;
+  actorMovies = actorStart + numActors + 1;
+  movieStart = actorMovies + numCredits;
+  movieActors = movieStart + numMovies + 1;
+}
+
+bool actorGraph::load(const string& fileName, const imdb& db) {
+  reset();
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return false;
+  struct stat stats;
+  if (fstat(fd, &stats) == -1 || (size_t) stats.st_size < sizeof(indexHeader))
+  {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(0, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return false;
+  mapped = map;
+  mappedSize = stats.st_size;
+
+  const indexHeader *header = (const indexHeader *) mapped;
+  size_t expected = sizeof(indexHeader) +
+    payloadLength(header->numActors, header->numMovies, header->numCredits, header->numRoles) * sizeof(uint32_t);
+  if (memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0 || mappedSize != expected ||
+      header->actorFileSize != db.actorFileSize() || header->movieFileSize != db.movieFileSize() ||
+      header->actorFileModified != db.actorFileModified() || header->movieFileModified != db.movieFileModified())
+  {
+    reset();
+    return false;
+  }
+
+  actorFileSize = header->actorFileSize;
+  movieFileSize = header->movieFileSize;
+  actorFileModified = header->actorFileModified;
+  movieFileModified = header->movieFileModified;
+  numActors = header->numActors;
+  numMovies = header->numMovies;
+  numCredits = header->numCredits;
+  numRoles = header->numRoles;
+  actorOffsets = (const uint32_t *)(header + 1);
+  movieOffsets = actorOffsets + numActors;
+  actorStart = movieOffsets + numMovies;
+  actorMovies = actorStart + numActors + 1;
+  movieStart = actorMovies + numCredits;
+  movieActors = movieStart + numMovies + 1;
+
+  // the offsets end up dereferenced inside the imdb's mappings, so a damaged index
+  // mustn't get that far
+  if (!allBelow(actorOffsets, numActors, actorFileSize) || !allBelow(movieOffsets, numMovies, movieFileSize) ||
+      !validStarts(actorStart, numActors, numCredits) || !allBelow(actorMovies, numCredits, numMovies) ||
+      !validStarts(movieStart, numMovies, numRoles) || !allBelow(movieActors, numRoles, numActors))
+  {
+    reset();
+    return false;
+  }
+  return true;
+}
+
+bool actorGraph::save(const string& fileName) const {
+  if (actorOffsets == NULL) return false;
+  indexHeader header;
+  memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+  header.actorFileSize = actorFileSize;
+  header.movieFileSize = movieFileSize;
+  header.actorFileModified = actorFileModified;
+  header.movieFileModified = movieFileModified;
+  header.numActors = numActors;
+  header.numMovies = numMovies;
+  header.numCredits = numCredits;
+  header.numRoles = numRoles;
+
+  // other servers may have the existing index mapped, and truncating it out from
+  // under them would crash them, so write a new file and rename it over the old one
+  string tmpFileName = fileName + ".tmp";
+  ofstream outfile(tmpFileName, ios::binary | ios::trunc);
+  outfile.write((const char *) &header, sizeof(header));
+  outfile.write((const char *) actorOffsets, payloadLength(numActors, numMovies, numCredits, numRoles) * sizeof(uint32_t));
+  outfile.close();
+  if (outfile.fail() || rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+  {
+    unlink(tmpFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Actor ids follow the imdb's sorted order, so a name can be binary searched
+ * right over actorOffsets.
+ */
+bool actorGraph::lookupActor(const imdb& db, string_view name, uint32_t& actor) const {
+  const uint32_t *end = actorOffsets + numActors;
+  const uint32_t *found = lower_bound(actorOffsets, end, name, [&db](uint32_t offset, string_view n) {
+    return db.actorRecord(offset).name < n;});
+  if (found == end || db.actorRecord(*found).name != name) return false;
+  actor = found - actorOffsets;
+  return true;
+}
+
+bool actorGraph::findShortestPath(const imdb& db, string_view source, string_view target, path& result) {
+  uint32_t ends[2];
+  if (!lookupActor(db, source, ends[0]) || !lookupActor(db, target, ends[1])) return false;
+  if (ends[0] == ends[1])
+  {
+    result = path(string(source));
+    return true;
+  }
+
+  if (++stamp == 0 || actorVisits[0].size() != numActors)
+  {
+    // first query (or the stamps wrapped around), so start every node off unvisited
+    for (int s = 0; s < 2; s++)
+    {
+      actorVisits[s].assign(numActors, visit{0, kNone, kNone});
+      movieStamps[s].assign(numMovies, 0);
+    }
+    stamp = 1;
+  }
+
+  vector<uint32_t> frontiers[2], next;
+  size_t depths[2] = {0, 0};
+  for (int s = 0; s < 2; s++)
+  {
+    actorVisits[s][ends[s]] = visit{stamp, kNone, kNone};
+    frontiers[s].push_back(ends[s]);
+  }
+
+  uint32_t meeting = kNone;
+  while (meeting == kNone && depths[0] + depths[1] < kMaxPathLength &&
+         !frontiers[0].empty() && !frontiers[1].empty())
+  {
+    int s = frontiers[0].size() <= frontiers[1].size() ? 0 : 1;
+    vector<visit>& visits = actorVisits[s];
+    const vector<visit>& otherVisits = actorVisits[1 - s];
+    vector<uint32_t>& movieVisits = movieStamps[s];
+    next.clear();
+    for (uint32_t a : frontiers[s])
+    {
+      for (uint32_t i = actorStart[a]; i < actorStart[a + 1] && meeting == kNone; i++)
+      {
+        uint32_t m = actorMovies[i];
+        if (movieVisits[m] == stamp) continue;
+        movieVisits[m] = stamp;
+        for (uint32_t j = movieStart[m]; j < movieStart[m + 1]; j++)
+        {
+          uint32_t b = movieActors[j];
+          if (visits[b].stamp == stamp) continue;
+          visits[b] = visit{stamp, a, m};
+          next.push_back(b);
+          if (otherVisits[b].stamp == stamp)
+          {
+            meeting = b;
+            break;
+          }
+        }
+      }
+      if (meeting != kNone) break;
+    }
+    frontiers[s].swap(next);
+    depths[s]++;
+  }
+  if (meeting == kNone) return false;
+
+  vector<uint32_t> chain;
+  for (uint32_t a = meeting; a != ends[0]; a = actorVisits[0][a].parentActor) chain.push_back(a);
+  result = path(string(source));
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+  {
+    const visit& v = actorVisits[0][*it];
+    result.addConnection(db.movieRecord(movieOffsets[v.viaMovie]).toFilm(), string(db.actorRecord(actorOffsets[*it]).name));
+  }
+  for (uint32_t a = meeting; a != ends[1]; a = actorVisits[1][a].parentActor)
+  {
+    const visit& v = actorVisits[1][a];
+    result.addConnection(db.movieRecord(movieOffsets[v.viaMovie]).toFilm(), string(db.actorRecord(actorOffsets[v.parentActor]).name));
+  }
+  return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "imdb.h"
+#include "path.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Class: actorGraph
+ * -----------------
+ * A compact, precomputed index of the actor<->movie graph, built once from an
+ * imdb and then queried over and over (see search-server.cc).  Actors and movies
+ * are renumbered 0..n-1 in the imdb's sorted order, and the adjacency lists are
+ * stored in compressed sparse row (CSR) form: the movies of actor a are
+ * actorMovies[actorStart[a]] through actorMovies[actorStart[a + 1] - 1], and the
+ * cast of movie m is laid out the same way in movieActors.  That's four flat
+ * arrays of 32-bit integers, so a search never touches the imdb's files until it
+ * has to translate its answer back into names.
+ *
+ * The index can be saved to a sidecar file and mapped back into memory on later
+ * starts, which skips the build entirely.  A sidecar is only accepted if it was
+ * built from data files of exactly the same sizes and modification times as the
+ * imdb it's paired with, and if every offset and id in it is in range.
+ *
+ * An actorGraph isn't safe to query from more than one thread at a time, since
+ * each query reuses the same scratch arrays.
+ */
+
+class actorGraph {
+ public:
+  actorGraph();
+  ~actorGraph();
+
+  /**
+   * Method: build
+   * -------------
+   * Builds the index from scratch by walking every actor in the specified imdb.
+   */
+  void build(const imdb& db);
+
+  /**
+   * Methods: load, save
+   * -------------------
+   * load maps a previously saved index into memory, returning false (and leaving the
+   * receiver empty) if the file is missing, malformed, or was built from different data.
+   * save writes the index to the named file, returning false if it couldn't.  It writes
+   * a temporary file and renames it into place, so anyone who has the old one mapped
+   * keeps using it undisturbed.
+   */
+  bool load(const std::string& fileName, const imdb& db);
+  bool save(const std::string& fileName) const;
+
+  size_t getNumActors() const { return numActors; }
+  size_t getNumMovies() const { return numMovies; }
+
+  /**
+   * Method: findShortestPath
+   * ------------------------
+   * Runs a bidirectional breadth-first search between the two named players over
+   * the index, always expanding the smaller frontier, and populates result with a
+   * shortest path of at most kMaxPathLength movies if there is one.
+   *
+   * @return true if and only if a path was found.
+   */
+  bool findShortestPath(const imdb& db, std::string_view source, std::string_view target, path& result);
+
+ private:
+  bool lookupActor(const imdb& db, std::string_view name, uint32_t& actor) const;
+  void reset();
+
+  // the arrays below point into owned after a build and into mapped after a load,
+  // and in both cases they're laid out back to back in the order they're declared
+  size_t actorFileSize, movieFileSize;
+  uint64_t actorFileModified, movieFileModified;
+  uint32_t numActors, numMovies, numCredits, numRoles;
+  const uint32_t *actorOffsets;  // actor id -> record offset in actordata
+  const uint32_t *movieOffsets;  // movie id -> record offset in moviedata
+  const uint32_t *actorStart, *actorMovies;
+  const uint32_t *movieStart, *movieActors;
+  std::vector<uint32_t> owned;
+  void *mapped;
+  size_t mappedSize;
+
+  // per-query scratch space: a node counts as visited by a side during the current
+  // query only if its stamp matches that side's stamp, so nothing is cleared between queries
+  struct visit {
+    uint32_t stamp;
+    uint32_t parentActor;
+    uint32_t viaMovie;
+  };
+  std::vector<visit> actorVisits[2];
+  std::vector<uint32_t> movieStamps[2];
+  uint32_t stamp;
+
+  actorGraph(const actorGraph& original) = delete;
+  actorGraph& operator=(const actorGraph& rhs) = delete;
+};
@@ -0,0 +1,197 @@
+/**
+ * File: imdb-bench.cc
+ * -------------------
+ * Micro-benchmark for imdb::getCredits and imdb::getCast.  A few thousand actors
+ * and films are sampled evenly from the data files, and each is looked up over
+ * and over through:
+ *
+ *    + a verbatim copy of the original lookup, which built a std::string (and,
+ *      for getCast, a whole film) for every probe of the binary search,
+ *    + the const std::string& / const film& versions of the imdb methods, and
+ *    + the std::string_view versions of the imdb methods.
+ *
+ * Each run reports lookups per second, so "before" and "after" can be compared
+ * side by side on the same data.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "imdb.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const size_t kNumSamples = 4096;
+static const int kNumRounds = 20;
+
+/**
+ * Function: mapFile
+ * -----------------
+ * Maps the named file read-only, returning NULL on failure.  The
+ * benchmark needs its own view of the raw files so it can sample
+ * keys and run the legacy lookup.
+ */
+static const char *mapFile(const string& fileName) {
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd == -1) return NULL;
+  struct stat stats;
+  fstat(fd, &stats);
+  void *map = mmap(0, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  return map == MAP_FAILED ? NULL : (const char *) map;
+}
+
+/**
+ * Functions: legacyGetCredits, legacyGetCast
+ * ------------------------------------------
+ * The original lookups, kept here only so there's a baseline to beat.  Every
+ * comparison inside lower_bound calls strlen and builds a std::string, and
+ * getCast builds a film per probe as well.
+ */
+static bool legacyGetCredits(const char *actorFile, const char *movieFile, const string& player, vector<film>& films) {
+  int numActors = *(int *)actorFile;
+  int *start = (int *)(actorFile + sizeof(int));
+  int *end = start + numActors;
+  int *lower = lower_bound(start, end, player, [actorFile](int elem, string v) {
+    const char *p = actorFile + elem; const string str(p, strlen(p)); return str < v;});
+  if (lower == end) return false;
+  const char *actor = actorFile + *lower;
+  int nameLength = strlen(actor);
+  if (string(actor, nameLength) != player) return false;
+  int alotted = nameLength + (nameLength % 2 == 0 ? 2 : 1);
+  short numMovies = *(short *)(actor + alotted);
+  const char *offsets = actor + alotted + sizeof(short) + ((alotted + sizeof(short)) % 4 != 0 ? 2 : 0);
+  for (short j = 0; j < numMovies; j++) {
+    const char *movie = movieFile + *(int *)(offsets + j * sizeof(int));
+    int titleLength = strlen(movie);
+    film f;
+    f.title = string(movie, titleLength);
+    f.year = *(char *)(movie + titleLength + 1) + 1900;
+    films.push_back(f);
+  }
+  return true;
+}
+
+static bool legacyGetCast(const char *actorFile, const char *movieFile, const film& movie, vector<string>& players) {
+  int numMovies = *(int *)movieFile;
+  int *start = (int *)(movieFile + sizeof(int));
+  int *end = start + numMovies;
+  int *lower = lower_bound(start, end, movie, [movieFile](int elem, struct film fval) {
+    const char *ms = movieFile + elem; int len = strlen(ms); const string str(ms, len);
+    film f; f.title = str; f.year = *(char *)(ms + len + 1) + 1900; return f < fval;});
+  if (lower == end) return false;
+  const char *ml = movieFile + *lower;
+  int titleLength = strlen(ml);
+  film found;
+  found.title = string(ml, titleLength);
+  found.year = *(char *)(ml + titleLength + 1) + 1900;
+  if (!(found == movie)) return false;
+  int alotted = titleLength + 2;
+  if (alotted % 2 != 0) alotted++;
+  short numActors = *(short *)(ml + alotted);
+  alotted += sizeof(short);
+  if (alotted % 4 != 0) alotted += 2;
+  for (short j = 0; j < numActors; j++) {
+    const char *actor = actorFile + *(int *)(ml + alotted + j * sizeof(int));
+    players.push_back(string(actor, strlen(actor)));
+  }
+  return true;
+}
+
+/**
+ * Function: sampleActors, sampleFilms
+ * -----------------------------------
+ * Pulls up to kNumSamples keys, spaced evenly across the sorted offset
+ * tables, so the lookups exercise the whole depth of the binary search.
+ */
+static vector<string> sampleActors(const char *actorFile) {
+  int numActors = *(int *)actorFile;
+  const int *offsets = (const int *)(actorFile + sizeof(int));
+  size_t stride = max<size_t>(1, numActors / kNumSamples);
+  vector<string> names;
+  for (size_t i = 0; i < (size_t) numActors && names.size() < kNumSamples; i += stride)
+    names.push_back(actorFile + offsets[i]);
+  return names;
+}
+
+static vector<film> sampleFilms(const char *movieFile) {
+  int numMovies = *(int *)movieFile;
+  const int *offsets = (const int *)(movieFile + sizeof(int));
+  size_t stride = max<size_t>(1, numMovies / kNumSamples);
+  vector<film> films;
+  for (size_t i = 0; i < (size_t) numMovies && films.size() < kNumSamples; i += stride) {
+    const char *ms = movieFile + offsets[i];
+    film f;
+    f.title = ms;
+    f.year = *(char *)(ms + f.title.size() + 1) + 1900;
+    films.push_back(f);
+  }
+  return films;
+}
+
+/**
+ * Function: report
+ * ----------------
+ * Runs the supplied lookup kNumRounds times over numKeys keys and
+ * prints the number of lookups per second.
+ */
+static void report(const string& label, size_t numKeys, const function<void(size_t)>& lookup) {
+  auto start = chrono::steady_clock::now();
+  for (int round = 0; round < kNumRounds; round++) {
+    for (size_t i = 0; i < numKeys; i++) lookup(i);
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  double lookups = (double) numKeys * kNumRounds;
+  cout << "  " << left << setw(32) << label << right << setw(12) << fixed << setprecision(0)
+       << lookups / elapsed.count() << " lookups/sec" << endl;
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc > 2) {
+    cerr << "Usage: " << argv[0] << " [<data-directory>]" << endl;
+    return kWrongArgumentCount;
+  }
+
+  const string directory = argc == 2 ? argv[1] : kIMDBDataDirectory;
+  imdb db(directory);
+  const char *actorFile = mapFile(directory + "/actordata");
+  const char *movieFile = mapFile(directory + "/moviedata");
+  if (!db.good() || actorFile == NULL || movieFile == NULL) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  vector<string> actors = sampleActors(actorFile);
+  vector<film> films = sampleFilms(movieFile);
+  vector<film> credits;
+  vector<string> cast;
+
+  cout << "getCredits over " << actors.size() << " actors:" << endl;
+  report("legacy (string per probe)", actors.size(), [&](size_t i) {
+    credits.clear(); legacyGetCredits(actorFile, movieFile, actors[i], credits); });
+  report("const string&", actors.size(), [&](size_t i) {
+    credits.clear(); db.getCredits(actors[i], credits); });
+  report("string_view", actors.size(), [&](size_t i) {
+    credits.clear(); db.getCredits(string_view(actors[i]), credits); });
+
+  cout << "getCast over " << films.size() << " films:" << endl;
+  report("legacy (film per probe)", films.size(), [&](size_t i) {
+    cast.clear(); legacyGetCast(actorFile, movieFile, films[i], cast); });
+  report("const film&", films.size(), [&](size_t i) {
+    cast.clear(); db.getCast(films[i], cast); });
+  report("string_view", films.size(), [&](size_t i) {
+    cast.clear(); db.getCast(string_view(films[i].title), films[i].year, cast); });
+  return 0;
+}
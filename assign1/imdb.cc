@@ -28,135 +28,195 @@ imdb::~imdb() {
   releaseFileMap(movieInfo);
 }
 
-bool imdb::getCredits(const string& player, vector<film>& films) const { 
+/**
+ * Compares the NUL-terminated name at the front of a mapped record against
+ * the supplied key, character by character, returning a negative number, zero,
+ * or a positive number just as strcmp would.  No strlen and no temporary
+ * std::string, since this runs once per probe of every binary search.
+ */
+static int compareRecordName(const char *record, string_view key)
+{
+  for (size_t i = 0; i < key.size(); i++)
+  {
+    unsigned char r = record[i];
+    unsigned char k = key[i];
+    if (r == '\0') return -1;
+    if (r != k) return r - k;
+  }
+  return record[key.size()] == '\0' ? 0 : 1;
+}
+
+static int recordYear(const char *movie_start, size_t name_length)
+{
+  return *(char *)(movie_start + name_length + 1) + 1900;
+}
+
+const int *imdb::findActor(string_view player) const
+{
   int numActors = *(int *)actorFile;
-  int *offset_base_start = (int *)((char *)actorFile + sizeof(int));
-  int *offset_base_end = (int *)((char *)actorFile + sizeof(int) + numActors * sizeof(int));
-  int *lower = std::lower_bound(offset_base_start, offset_base_end, player, [this](int elem, std::string v){char *p = (char *)actorFile + elem; int name_length = strlen(p); const string str(p,name_length); return str < v;});  
+  const int *offset_base_start = (const int *)((char *)actorFile + sizeof(int));
+  const int *offset_base_end = offset_base_start + numActors;
+  const int *lower = std::lower_bound(offset_base_start, offset_base_end, player, [this](int elem, string_view v){
+    return compareRecordName((char *)actorFile + elem, v) < 0;});
+  if (lower == offset_base_end || compareRecordName((char *)actorFile + *lower, player) != 0)
+  {
+    return NULL;
+  }
+  return lower;
+}
+
+const int *imdb::findMovie(string_view title, int year) const
+{
+  int numMovies = *(int *)movieFile;
+  const int *offset_base_start = (const int *)((char *)movieFile + sizeof(int));
+  const int *offset_base_end = offset_base_start + numMovies;
+  // films order by title first and year second, so the year is only consulted on a title tie
+  const int *lower = std::lower_bound(offset_base_start, offset_base_end, title, [this, year](int elem, string_view t){
+    const char *ms = (char *)movieFile + elem;
+    int cmp = compareRecordName(ms, t);
+    if (cmp != 0) return cmp < 0;
+    return recordYear(ms, t.size()) < year;});
   if (lower == offset_base_end)
   {
-    return false;
+    return NULL;
   }
-  bool found;
-  char *actor_start = (char *)actorFile + *lower;
-  int name_length = strlen(actor_start);
-  const string str(actor_start, name_length);
-  if (actor_start != player)
+  const char *ml = (char *)movieFile + *lower;
+  if (compareRecordName(ml, title) != 0 || recordYear(ml, title.size()) != year)
   {
-    found = false;
+    return NULL;
   }
-  else
+  return lower;
+}
+
+bool imdb::getCredits(const string& player, vector<film>& films) const { 
+  return getCredits(string_view(player), films);
+}
+
+/**
+ * Locates the array of movie offsets trailing an actor record.  The name
+ * (plus its terminating \0) is padded to an even length, followed by a
+ * short count of movies, padded again so the offsets that follow
+ * start on a four-byte boundary.
+ */
+static const int *actorRecordOffsets(const char *actor_start, size_t name_length, short& numMovies)
+{
+  int alotted_length = name_length % 2 == 0 ? name_length + 2 : name_length + 1;
+  numMovies = *(short *)(actor_start + alotted_length);
+  int sum_alotted_length = alotted_length + sizeof(short);
+  if (sum_alotted_length % 4 != 0)
   {
-    found = true;
-    int alotted_length;
-    if (name_length % 2 == 0)
-    {
-      alotted_length = name_length + 2;
-    }
-    else
-    {
-      alotted_length = name_length + 1;
-    }
-    void *numMoviesaddr = (char *)actor_start + alotted_length;
-    short numMovies = *(short *)numMoviesaddr;
-    int sum_alotted_length = alotted_length + sizeof(short);
-    void *movieOffsetaddr = (char *)numMoviesaddr + sizeof(short);
-    if (sum_alotted_length % 4 != 0)
-    {
-      movieOffsetaddr = (char *)movieOffsetaddr + 2;
-    } 
-    for (short j = 0; j < numMovies; j++)
-    {
-      int movie_offset_j = *(int *)((char *)movieOffsetaddr + (j * sizeof(int)));
-      char *movie_start = (char *)movieFile + movie_offset_j;
-      int movie_name_length = strlen(movie_start);
-      const string str_m(movie_start, movie_name_length);
-      int moviename_alotted_length = movie_name_length + 1;
-      void *year_addr = movie_start + moviename_alotted_length;
-      int movie_year = *(char *)year_addr;
-      movie_year += 1900;
-      struct film filmstruct;
-      filmstruct.title = str_m;
-      filmstruct.year = movie_year;
-      films.push_back(filmstruct);
-    } 
+    sum_alotted_length += 2;
   }
-  return found;
+  return (const int *)(actor_start + sum_alotted_length);
 }
 
-bool imdb::getCast(const film& movie, vector<string>& players) const { 
+/**
+ * Locates the array of actor offsets trailing a movie record.  Same idea as
+ * above, except the title's \0 is followed by a single year byte before the
+ * padding to an even length.
+ */
+static const int *movieRecordOffsets(const char *movie_start, size_t name_length, short& numActors)
+{
+  int sum_alotted_length = name_length + 2;
+  if (sum_alotted_length % 2 != 0)
+  {
+    sum_alotted_length += 1;
+  }
+  numActors = *(short *)(movie_start + sum_alotted_length);
+  sum_alotted_length += sizeof(short);
+  if (sum_alotted_length % 4 != 0)
+  {
+    sum_alotted_length += 2;
+  }
+  return (const int *)(movie_start + sum_alotted_length);
+}
 
-  int numMovies = *(int *)movieFile;
-  int *offset_base_start = (int *)((char *)movieFile + sizeof(int));
-  int *offset_base_end = (int *)((char *)movieFile + sizeof(int) + numMovies * sizeof(int));
-  
-  int *lower = std::lower_bound(offset_base_start, offset_base_end, movie, [this] (int elem, struct film fval){char *ms = (char *)movieFile + elem; 
-  int name_length = strlen(ms); const string str(ms, name_length); void *year_addr = ms + name_length + 1; int movie_year = *(char *)year_addr; 
-  movie_year += 1900; struct film film_iter; film_iter.title = str;
-  film_iter.year = movie_year; return film_iter < fval;});                                                                                                  
-  if (lower == offset_base_end)
+bool imdb::getCredits(string_view player, vector<film>& films) const { 
+  const int *lower = findActor(player);
+  if (lower == NULL)
   {
     return false;
-  } 
-  char *ml = (char *)movieFile + *lower;
-  int name_length = strlen(ml);
-  const string strl(ml, name_length);
-  void *year_addr = ml + name_length + 1;
-  int movie_year = *(char *)year_addr;
-  movie_year += 1900;
-
-  bool found;
-  
-  if ((strl == movie.title) && (movie_year == movie.year))
+  }
+  creditRange range = credits((uint32_t) *lower);
+  films.reserve(films.size() + range.size());
+  for (const credit& c : range)
   {
-    found = true;
-    int moviename_alotted_length = name_length + 1;
-    int sum_alotted_length = moviename_alotted_length + 1;
-      
-    // if this length is odd, add extra \0
-    if (sum_alotted_length % 2 != 0)
-    {
-      //numActorsaddr = (char *)numActorsaddr + 1;
-      sum_alotted_length += 1;
-    }
-    //sum_alotted_length contains length of movie name and year
-    void *numActorsaddr = ml + sum_alotted_length;
-      
-    short numActors = *(short *)numActorsaddr;
-      
-    //add the size of the number of Actors to sum_alotted_length
-    sum_alotted_length += sizeof(short);
-
-    //pad with two additional bytes of zeros if not a multiple of four
-    if (sum_alotted_length % 4 != 0)
-    {
-      //add with 4 - l % 4 
-      sum_alotted_length += 2;
-    }
-
-    void *actorOffsetaddr = ml + sum_alotted_length;
-    for (short j = 0; j < numActors; j++)
-    {
-      int actor_offset_j = *(int *)((char *)actorOffsetaddr + (j * sizeof(int)));
-      char *actor_start = (char *)actorFile + actor_offset_j;
-      int actor_name_length = strlen(actor_start);
-      const string str_a(actor_start, actor_name_length);
-      players.push_back(str_a);
-    }
-    
+    films.push_back(c.toFilm());
   }
-  else
+  return true;
+}
+
+bool imdb::getCast(const film& movie, vector<string>& players) const { 
+  return getCast(string_view(movie.title), movie.year, players);
+}
+
+bool imdb::getCast(string_view title, int year, vector<string>& players) const { 
+  const int *lower = findMovie(title, year);
+  if (lower == NULL)
+  {
+    return false;
+  } 
+  castRange range = cast((uint32_t) *lower);
+  players.reserve(players.size() + range.size());
+  for (const castMember& m : range)
   {
-    found = false;
+    players.emplace_back(m.name);
   }
-  return found;
-  
+  return true;
+}
+
+creditRange imdb::credits(string_view player) const {
+  const int *lower = findActor(player);
+  return lower == NULL ? creditRange() : credits((uint32_t) *lower);
+}
+
+creditRange imdb::credits(uint32_t actorOffset) const {
+  const char *actor_start = (char *)actorFile + actorOffset;
+  short numMovies;
+  const int *offsets = actorRecordOffsets(actor_start, strlen(actor_start), numMovies);
+  return creditRange((char *)movieFile, offsets, numMovies);
+}
+
+castRange imdb::cast(string_view title, int year) const {
+  const int *lower = findMovie(title, year);
+  return lower == NULL ? castRange() : cast((uint32_t) *lower);
+}
+
+castRange imdb::cast(uint32_t movieOffset) const {
+  const char *movie_start = (char *)movieFile + movieOffset;
+  short numActors;
+  const int *offsets = movieRecordOffsets(movie_start, strlen(movie_start), numActors);
+  return castRange((char *)actorFile, offsets, numActors);
+}
+
+bool imdb::lookupActor(string_view player, uint32_t& actorOffset) const {
+  const int *lower = findActor(player);
+  if (lower == NULL) return false;
+  actorOffset = *lower;
+  return true;
+}
+
+castRange imdb::allActors() const {
+  return castRange((char *)actorFile, (const int *)((char *)actorFile + sizeof(int)), *(int *)actorFile);
+}
+
+creditRange imdb::allMovies() const {
+  return creditRange((char *)movieFile, (const int *)((char *)movieFile + sizeof(int)), *(int *)movieFile);
+}
+
+castMember imdb::actorRecord(uint32_t actorOffset) const {
+  return castMember::decode((char *)actorFile, actorOffset);
+}
+
+credit imdb::movieRecord(uint32_t movieOffset) const {
+  return credit::decode((char *)movieFile, movieOffset);
 }
 
 const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info) {
   struct stat stats;
   stat(fileName.c_str(), &stats);
   info.fileSize = stats.st_size;
+  info.modified = (uint64_t) stats.st_mtim.tv_sec * 1000000000 + stats.st_mtim.tv_nsec;
   info.fd = open(fileName.c_str(), O_RDONLY);
   return info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
 }
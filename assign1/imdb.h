@@ -1,8 +1,94 @@
 #pragma once
 #include "imdb-utils.h"
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * Convenience structs: credit, castMember
+ * ---------------------------------------
+ * Lightweight views of single movie and actor records, decoded in place
+ * from the memory-mapped data files.  The string_views point straight into
+ * the mapped files, so they remain valid for as long as the imdb that
+ * produced them is alive, and nothing is copied or allocated to produce
+ * them.  The offsets are the byte offsets of the records within moviedata
+ * and actordata, which uniquely (and compactly) identify films and players.
+ */
+struct credit {
+  std::string_view title;
+  int year;
+  uint32_t movieOffset;
+
+  film toFilm() const { film f; f.title.assign(title.data(), title.size()); f.year = year; return f; }
+  static credit decode(const char *movieFile, uint32_t offset) {
+    const char *record = movieFile + offset;
+    size_t length = strlen(record);
+    return credit{std::string_view(record, length), *(const char *)(record + length + 1) + 1900, offset};
+  }
+};
+
+struct castMember {
+  std::string_view name;
+  uint32_t actorOffset;
+
+  static castMember decode(const char *actorFile, uint32_t offset) {
+    return castMember{std::string_view(actorFile + offset), offset};
+  }
+};
+
+/**
+ * Convenience class: recordRange
+ * ------------------------------
+ * A lazy, read-only range over the array of record offsets embedded in an
+ * actor or movie record.  Dereferencing an iterator decodes the referenced
+ * record on the spot (via Record::decode), so walking a range allocates nothing.
+ * A default-constructed range is empty, which is what lookups of unknown
+ * actors and films hand back.
+ */
+template <typename Record>
+class recordRange {
+ public:
+  class iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Record value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const Record *pointer;
+    typedef Record reference;
+
+    iterator(const char *base, const int *pos) : base(base), pos(pos) {}
+    Record operator*() const { return Record::decode(base, *pos); }
+    iterator& operator++() { ++pos; return *this; }
+    iterator operator++(int) { iterator old = *this; ++pos; return old; }
+    bool operator==(const iterator& rhs) const { return pos == rhs.pos; }
+    bool operator!=(const iterator& rhs) const { return pos != rhs.pos; }
+
+   private:
+    const char *base;
+    const int *pos;
+  };
+
+  recordRange() : base(NULL), first(NULL), count(0) {}
+  recordRange(const char *base, const int *first, size_t count) : base(base), first(first), count(count) {}
+
+  iterator begin() const { return iterator(base, first); }
+  iterator end() const { return iterator(base, first + count); }
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  Record operator[](size_t i) const { return Record::decode(base, first[i]); }
+
+ private:
+  const char *base;
+  const int *first;
+  size_t count;
+};
+
+typedef recordRange<credit> creditRange;
+typedef recordRange<castMember> castRange;
+
 class imdb {
  public:
   
@@ -50,6 +136,18 @@ class imdb {
   
   bool getCredits(const std::string& player, std::vector<film>& films) const;
 
+/**
+ * Method: getCredits
+ * ------------------
+ * Same as above, except that the actor/actress is identified by a string_view,
+ * so clients holding names that live elsewhere (argv, other mapped records, etc.)
+ * needn't manufacture a std::string just to ask the question.  The binary search
+ * compares the supplied characters directly against the mapped actordata
+ * records and allocates nothing.
+ */
+
+  bool getCredits(std::string_view player, std::vector<film>& films) const;
+
 /**
  * Method: getCast
  * ---------------
@@ -69,6 +167,85 @@ class imdb {
 
   bool getCast(const film& movie, std::vector<std::string>& players) const;
 
+/**
+ * Method: getCast
+ * ---------------
+ * Same as above, except that the film is identified by its title (as a string_view)
+ * and year rather than by a film record.  As with the string_view version of
+ * getCredits, the lookup itself compares directly against the mapped moviedata
+ * records and allocates nothing.
+ */
+
+  bool getCast(std::string_view title, int year, std::vector<std::string>& players) const;
+
+/**
+ * Methods: credits, cast
+ * ----------------------
+ * Zero-copy alternatives to getCredits and getCast.  Rather than
+ * populating a vector with freshly allocated strings, each returns a
+ * lazy range over the actor's (or film's) record, decoded in place from
+ * the mapped data files as it's iterated.  Players and films are named either
+ * by key or by record offset, where the offsets are those surfaced through
+ * castMember::actorOffset and credit::movieOffset.  Unknown players and films
+ * produce empty ranges.  The offset versions do no searching at all and
+ * blindly trust that the offset came from this imdb.
+ *
+ * @return a range of credits (or cast members) that remains valid for as
+ *         long as the receiving imdb is alive.
+ */
+
+  creditRange credits(std::string_view player) const;
+  creditRange credits(uint32_t actorOffset) const;
+  castRange cast(std::string_view title, int year) const;
+  castRange cast(uint32_t movieOffset) const;
+
+/**
+ * Methods: lookupActor, actorRecord, movieRecord
+ * ----------------------------------------------
+ * Translate between names and record offsets.  lookupActor binary searches
+ * for the named player and, if found, surfaces the offset of the player's
+ * record within actordata.  actorRecord and movieRecord go the other way and
+ * decode the record at the supplied offset, which is trusted to have come
+ * from this imdb.
+ *
+ * @return lookupActor returns true if and only if the player is in the database.
+ */
+
+  bool lookupActor(std::string_view player, uint32_t& actorOffset) const;
+  castMember actorRecord(uint32_t actorOffset) const;
+  credit movieRecord(uint32_t movieOffset) const;
+
+/**
+ * Methods: allActors, allMovies
+ * -----------------------------
+ * Return lazy ranges over every actor (sorted by name) and every film (sorted by
+ * title, then year) in the database, for clients that need to index everything.
+ */
+
+  castRange allActors() const;
+  creditRange allMovies() const;
+
+/**
+ * Methods: actorFileSize, movieFileSize
+ * -------------------------------------
+ * Return the sizes, in bytes, of the mapped actordata and moviedata files.
+ * Every record offset is strictly less than the size of its file, so clients
+ * can size dense tables indexed by offset.
+ */
+
+  size_t actorFileSize() const { return actorInfo.fileSize; }
+  size_t movieFileSize() const { return movieInfo.fileSize; }
+
+/**
+ * Methods: actorFileModified, movieFileModified
+ * ---------------------------------------------
+ * Return the last modification times of the actordata and moviedata files, in
+ * nanoseconds since the epoch, for clients that save anything derived from them.
+ */
+
+  uint64_t actorFileModified() const { return actorInfo.modified; }
+  uint64_t movieFileModified() const { return movieInfo.modified; }
+
 /**
  * Destructor: ~imdb
  * -----------------
@@ -88,9 +265,13 @@ class imdb {
   struct fileInfo {
     int fd;
     size_t fileSize;
+    uint64_t modified;
     const void *fileMap;
   } actorInfo, movieInfo;
   
+  const int *findActor(std::string_view player) const;
+  const int *findMovie(std::string_view title, int year) const;
+  
   static const void *acquireFileMap(const std::string& fileName, struct fileInfo& info);
   static void releaseFileMap(struct fileInfo& info);
 
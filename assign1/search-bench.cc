@@ -0,0 +1,135 @@
+/**
+ * File: search-bench.cc
+ * ---------------------
+ * Benchmarks the one-sided strategy the search executable used to run (count both endpoints'
+ * costars, then BFS out from the one with fewer) against the bidirectional
+ * search it runs now, over a fixed set of actor pairs.  Pairs can be
+ * supplied in a file, one tab-separated source/target pair per line;
+ * otherwise a built-in list of well-known pairs is used.  Pairs naming
+ * people who aren't in the database are skipped.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "imdb.h"
+#include "path.h"
+#include "search-engine.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kPairsFileNotFound = 3;
+static const int kNumRounds = 3;
+
+static const pair<string, string> kDefaultPairs[] = {
+  {"Kevin Bacon", "Meryl Streep"},
+  {"Carrie Fisher", "Kevin Bacon"},
+  {"Jack Nicholson", "Mary Tyler Moore"},
+  {"Julia Roberts", "Rebecca De Mornay"},
+  {"Leonardo DiCaprio", "Nicolas Cage"},
+  {"Keanu Reeves", "Hugh Grant"},
+  {"Tom Hanks", "Marilyn Monroe"},
+  {"Natalie Portman", "Harrison Ford"}
+};
+
+/**
+ * Function: loadPairs
+ * -------------------
+ * Reads tab-separated source/target pairs, one per line, from the named file.
+ */
+static bool loadPairs(const string& fileName, vector<pair<string, string>>& pairs) {
+  ifstream infile(fileName);
+  if (infile.fail()) return false;
+  string line;
+  while (getline(infile, line)) {
+    size_t tab = line.find('\t');
+    if (tab == string::npos) continue;
+    pairs.push_back(make_pair(line.substr(0, tab), line.substr(tab + 1)));
+  }
+  return true;
+}
+
+/**
+ * Function: oneSided
+ * ------------------
+ * The strategy search used before the bidirectional engine: count each endpoint's
+ * costars, search from the one with fewer, and reverse the path if need be.
+ */
+static bool oneSided(const imdb& db, const string& source, const string& target, path& result) {
+  if (countCostars(db, target) < countCostars(db, source)) {
+    if (!findShortestPath(db, target, source, result)) return false;
+    result.reverse();
+    return true;
+  }
+  return findShortestPath(db, source, target, result);
+}
+
+/**
+ * Function: timeSearch
+ * --------------------
+ * Runs the supplied search kNumRounds times and returns the average
+ * number of milliseconds per search, recording the length of the path
+ * found (or -1 if there isn't one).
+ */
+template <typename Search>
+static double timeSearch(Search search, const imdb& db, const pair<string, string>& p, int& length) {
+  auto start = chrono::steady_clock::now();
+  for (int round = 0; round < kNumRounds; round++) {
+    path result(p.first);
+    length = search(db, p.first, p.second, result) ? result.getLength() : -1;
+  }
+  chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count() / kNumRounds;
+}
+
+int main(int argc, const char *argv[]) {
+  if (argc > 3) {
+    cerr << "Usage: " << argv[0] << " [<data-directory> [<pairs-file>]]" << endl;
+    return kWrongArgumentCount;
+  }
+
+  imdb db(argc >= 2 ? argv[1] : kIMDBDataDirectory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  vector<pair<string, string>> pairs;
+  if (argc == 3) {
+    if (!loadPairs(argv[2], pairs)) {
+      cerr << "Couldn't open \"" << argv[2] << "\".  Aborting..." << endl;
+      return kPairsFileNotFound;
+    }
+  } else {
+    pairs.assign(begin(kDefaultPairs), end(kDefaultPairs));
+  }
+
+  double oneSidedTotal = 0, bidirectionalTotal = 0;
+  cout << setw(12) << "one-sided" << setw(16) << "bidirectional" << setw(8) << "hops" << "  pair" << endl;
+  for (const pair<string, string>& p : pairs) {
+    uint32_t offset;
+    if (!db.lookupActor(p.first, offset) || !db.lookupActor(p.second, offset)) {
+      cout << "  (skipping " << p.first << " -> " << p.second << ": not in database)" << endl;
+      continue;
+    }
+    int oneSidedLength, bidirectionalLength;
+    double oneSidedTime = timeSearch(oneSided, db, p, oneSidedLength);
+    double bidirectionalTime = timeSearch(findShortestPathBidirectional, db, p, bidirectionalLength);
+    oneSidedTotal += oneSidedTime;
+    bidirectionalTotal += bidirectionalTime;
+    cout << fixed << setprecision(2) << setw(10) << oneSidedTime << "ms" << setw(14) << bidirectionalTime << "ms"
+         << setw(8) << bidirectionalLength << "  " << p.first << " -> " << p.second;
+    if (oneSidedLength != bidirectionalLength) cout << "  (one-sided found " << oneSidedLength << " hops!)";
+    cout << endl;
+  }
+
+  cout << fixed << setprecision(2) << setw(10) << oneSidedTotal << "ms" << setw(14) << bidirectionalTotal << "ms" << "  total";
+  if (bidirectionalTotal > 0) cout << " (" << setprecision(1) << oneSidedTotal / bidirectionalTotal << "x speedup)";
+  cout << endl;
+  return 0;
+}
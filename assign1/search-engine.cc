@@ -0,0 +1,404 @@
+#include "search-engine.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace std;
+
+size_t countCostars(const imdb& db, const string& player)
+{
+  uint32_t playerOffset;
+  if (!db.lookupActor(player, playerOffset)) return 0;
+  offsetBitmap costars(db.actorFileSize());
+  costars.insert(playerOffset);
+  size_t numCostars = 0;
+  for (const credit& movie : db.credits(playerOffset))
+  {
+    for (const castMember& costar : db.cast(movie.movieOffset))
+    {
+      if (costars.insert(costar.actorOffset)) numCostars++;
+    }
+  }
+  return numCostars;
+}
+
+/**
+ * Type: discovery
+ * ---------------
+ * One entry per discovered actor.  The entries double as the BFS queue
+ * (everything from the head onward is still to be expanded) and as the
+ * parent-pointer array used to rebuild the path: each entry names the movie
+ * that led to the actor and the index of the entry that was being expanded.
+ */
+struct discovery {
+  uint32_t actorOffset;
+  uint32_t movieOffset;
+  int parent;
+  int depth;
+};
+
+/**
+ * Functions: appendPathFromRoot, appendPathToRoot
+ * -----------------------------------------------
+ * Follow the parent pointers from the specified entry back to the root of
+ * the search (entry 0), appending the connections to result in
+ * root-to-entry or entry-to-root order, respectively.
+ */
+static void appendPathFromRoot(const imdb& db, const vector<discovery>& discovered, int index, path& result)
+{
+  vector<int> chain;
+  for (int i = index; discovered[i].parent != -1; i = discovered[i].parent)
+  {
+    chain.push_back(i);
+  }
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+  {
+    const discovery& d = discovered[*it];
+    result.addConnection(db.movieRecord(d.movieOffset).toFilm(), string(db.actorRecord(d.actorOffset).name));
+  }
+}
+
+static void appendPathToRoot(const imdb& db, const vector<discovery>& discovered, int index, path& result)
+{
+  for (int i = index; discovered[i].parent != -1; i = discovered[i].parent)
+  {
+    const discovery& d = discovered[i];
+    uint32_t nextActor = discovered[d.parent].actorOffset;
+    result.addConnection(db.movieRecord(d.movieOffset).toFilm(), string(db.actorRecord(nextActor).name));
+  }
+}
+
+bool findShortestPath(const imdb& db, const string& source, const string& target, path& result)
+{
+  uint32_t sourceOffset, targetOffset;
+  if (!db.lookupActor(source, sourceOffset) || !db.lookupActor(target, targetOffset)) return false;
+
+  offsetBitmap visitedActors(db.actorFileSize());
+  offsetBitmap visitedFilms(db.movieFileSize());
+  vector<discovery> discovered;
+  discovered.push_back({sourceOffset, 0, -1, 0});
+  visitedActors.insert(sourceOffset);
+  for (size_t head = 0; head < discovered.size(); head++)
+  {
+    const discovery curr = discovered[head];
+    if (curr.depth == (int) kMaxPathLength) break;
+    for (const credit& movie : db.credits(curr.actorOffset))
+    {
+      if (!visitedFilms.insert(movie.movieOffset)) continue;
+      for (const castMember& costar : db.cast(movie.movieOffset))
+      {
+        if (!visitedActors.insert(costar.actorOffset)) continue;
+        discovered.push_back({costar.actorOffset, movie.movieOffset, (int) head, curr.depth + 1});
+        if (costar.actorOffset == targetOffset)
+        {
+          result = path(source);
+          appendPathFromRoot(db, discovered, discovered.size() - 1, result);
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * Type: searchSide
+ * ----------------
+ * Bundles everything one half of a bidirectional search needs.  The entries
+ * from levelStart onward are the frontier still to be expanded, and depth is
+ * the number of levels expanded so far.
+ */
+struct searchSide {
+  searchSide(const imdb& db, uint32_t root) :
+    visitedActors(db.actorFileSize()), visitedFilms(db.movieFileSize()), levelStart(0), depth(0) {
+    discovered.push_back({root, 0, -1, 0});
+    visitedActors.insert(root);
+  }
+
+  size_t frontierSize() const { return discovered.size() - levelStart; }
+
+  offsetBitmap visitedActors;
+  offsetBitmap visitedFilms;
+  vector<discovery> discovered;
+  size_t levelStart;
+  size_t depth;
+};
+
+/**
+ * Function: expandLevel
+ * ---------------------
+ * Expands every actor in the side's frontier by one movie.  Returns the index
+ * of the first newly discovered actor the other side has already seen, or
+ * -1 if the two searches didn't meet (in which case the newly discovered
+ * actors become the next frontier).
+ */
+static int expandLevel(const imdb& db, searchSide& side, const searchSide& other)
+{
+  size_t levelEnd = side.discovered.size();
+  for (size_t i = side.levelStart; i < levelEnd; i++)
+  {
+    const discovery curr = side.discovered[i];
+    for (const credit& movie : db.credits(curr.actorOffset))
+    {
+      if (!side.visitedFilms.insert(movie.movieOffset)) continue;
+      for (const castMember& costar : db.cast(movie.movieOffset))
+      {
+        if (!side.visitedActors.insert(costar.actorOffset)) continue;
+        side.discovered.push_back({costar.actorOffset, movie.movieOffset, (int) i, curr.depth + 1});
+        if (other.visitedActors.contains(costar.actorOffset)) return side.discovered.size() - 1;
+      }
+    }
+  }
+  side.levelStart = levelEnd;
+  side.depth++;
+  return -1;
+}
+
+static int findDiscovery(const searchSide& side, uint32_t actorOffset)
+{
+  for (size_t i = 0; i < side.discovered.size(); i++)
+  {
+    if (side.discovered[i].actorOffset == actorOffset) return i;
+  }
+  return -1;
+}
+
+bool findShortestPathBidirectional(const imdb& db, const string& source, const string& target, path& result)
+{
+  uint32_t sourceOffset, targetOffset;
+  if (!db.lookupActor(source, sourceOffset) || !db.lookupActor(target, targetOffset)) return false;
+  if (sourceOffset == targetOffset)
+  {
+    result = path(source);
+    return true;
+  }
+
+  searchSide forward(db, sourceOffset);
+  searchSide backward(db, targetOffset);
+  while (forward.depth + backward.depth < kMaxPathLength &&
+         forward.frontierSize() > 0 && backward.frontierSize() > 0)
+  {
+    bool expandForward = forward.frontierSize() <= backward.frontierSize();
+    searchSide& side = expandForward ? forward : backward;
+    const searchSide& other = expandForward ? backward : forward;
+    int meeting = expandLevel(db, side, other);
+    if (meeting == -1) continue;
+
+    int otherMeeting = findDiscovery(other, side.discovered[meeting].actorOffset);
+    int forwardMeeting = expandForward ? meeting : otherMeeting;
+    int backwardMeeting = expandForward ? otherMeeting : meeting;
+    result = path(source);
+    appendPathFromRoot(db, forward.discovered, forwardMeeting, result);
+    appendPathToRoot(db, backward.discovered, backwardMeeting, result);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * Class: levelPool
+ * ----------------
+ * A fixed set of threads that all run the same task, once per level of a
+ * parallel search.  run hands the task to every worker (the calling thread
+ * acts as worker 0) and returns once all of them have finished it, which is
+ * the barrier between one level and the next.  The threads live for the
+ * whole search, so a level costs a wakeup rather than a thread launch.
+ */
+class levelPool {
+ public:
+  levelPool(size_t numThreads) : task(NULL), generation(0), numRunning(0), done(false)
+  {
+    for (size_t id = 1; id < numThreads; id++) workers.emplace_back([this, id] { work(id); });
+  }
+
+  ~levelPool()
+  {
+    {
+      lock_guard<mutex> lg(m);
+      done = true;
+    }
+    taskReady.notify_all();
+    for (thread& t : workers) t.join();
+  }
+
+  size_t size() const { return workers.size() + 1; }
+
+  void run(const function<void(size_t)>& levelTask)
+  {
+    {
+      lock_guard<mutex> lg(m);
+      task = &levelTask;
+      numRunning = workers.size();
+      generation++;
+    }
+    taskReady.notify_all();
+    levelTask(0);
+    unique_lock<mutex> ul(m);
+    taskDone.wait(ul, [this] { return numRunning == 0; });
+  }
+
+ private:
+  void work(size_t id)
+  {
+    size_t seen = 0;
+    while (true)
+    {
+      const function<void(size_t)> *current;
+      {
+        unique_lock<mutex> ul(m);
+        taskReady.wait(ul, [this, seen] { return done || generation != seen; });
+        if (done) return;
+        seen = generation;
+        current = task;
+      }
+      (*current)(id);
+      lock_guard<mutex> lg(m);
+      if (--numRunning == 0) taskDone.notify_one();
+    }
+  }
+
+  vector<thread> workers;
+  mutex m;
+  condition_variable taskReady, taskDone;
+  const function<void(size_t)> *task;
+  size_t generation;
+  size_t numRunning;
+  bool done;
+};
+
+/**
+ * Type: parallelSide
+ * ------------------
+ * The parallel counterpart of searchSide.  discovered is only ever appended
+ * to between levels, so the workers can all read the frontier out of it freely.
+ */
+struct parallelSide {
+  parallelSide(const imdb& db, uint32_t root) :
+    visitedActors(db.actorFileSize()), visitedFilms(db.movieFileSize()), levelStart(0), depth(0) {
+    discovered.push_back({root, 0, -1, 0});
+    visitedActors.insert(root);
+  }
+
+  size_t frontierSize() const { return discovered.size() - levelStart; }
+
+  atomicOffsetBitmap visitedActors;
+  atomicOffsetBitmap visitedFilms;
+  vector<discovery> discovered;
+  size_t levelStart;
+  size_t depth;
+};
+
+// frontier entries handed to a worker at a time: small enough that one worker
+// stuck with a hub actor doesn't hold up the level, big enough to keep the
+// shared counter cool
+static const size_t kFrontierChunkSize = 16;
+
+/**
+ * Function: expandLevelParallel
+ * -----------------------------
+ * Does what expandLevel does, split across the pool.  Each worker keeps its
+ * discoveries in its own list, and the lists are appended to side.discovered
+ * once the whole pool is through.  Any one meeting found during a level is as
+ * good as any other (they all make for paths of the same length), so the
+ * first worker to find one tells the rest to stop early.
+ */
+static int expandLevelParallel(const imdb& db, parallelSide& side, const parallelSide& other, levelPool& pool)
+{
+  size_t levelEnd = side.discovered.size();
+  atomic<size_t> nextChunk(side.levelStart);
+  atomic<bool> met(false);
+  vector<vector<discovery>> found(pool.size());
+  vector<int> meetings(pool.size(), -1);
+  pool.run([&](size_t id) {
+    vector<discovery>& local = found[id];
+    while (!met.load(memory_order_relaxed))
+    {
+      size_t chunkStart = nextChunk.fetch_add(kFrontierChunkSize);
+      if (chunkStart >= levelEnd) return;
+      size_t chunkEnd = min(chunkStart + kFrontierChunkSize, levelEnd);
+      for (size_t i = chunkStart; i < chunkEnd; i++)
+      {
+        const discovery& curr = side.discovered[i];
+        for (const credit& movie : db.credits(curr.actorOffset))
+        {
+          if (!side.visitedFilms.insert(movie.movieOffset)) continue;
+          for (const castMember& costar : db.cast(movie.movieOffset))
+          {
+            if (!side.visitedActors.insert(costar.actorOffset)) continue;
+            local.push_back({costar.actorOffset, movie.movieOffset, (int) i, curr.depth + 1});
+            if (other.visitedActors.contains(costar.actorOffset))
+            {
+              meetings[id] = local.size() - 1;
+              met = true;
+              return;
+            }
+          }
+        }
+      }
+    }
+  });
+
+  int meeting = -1;
+  for (size_t id = 0; id < found.size(); id++)
+  {
+    if (meeting == -1 && meetings[id] != -1) meeting = side.discovered.size() + meetings[id];
+    side.discovered.insert(side.discovered.end(), found[id].begin(), found[id].end());
+  }
+  if (meeting != -1) return meeting;
+  side.levelStart = levelEnd;
+  side.depth++;
+  return -1;
+}
+
+static int findDiscovery(const parallelSide& side, uint32_t actorOffset)
+{
+  for (size_t i = 0; i < side.discovered.size(); i++)
+  {
+    if (side.discovered[i].actorOffset == actorOffset) return i;
+  }
+  return -1;
+}
+
+bool findShortestPathParallel(const imdb& db, const string& source, const string& target, path& result,
+                              size_t numThreads, vector<levelStats> *stats)
+{
+  uint32_t sourceOffset, targetOffset;
+  if (!db.lookupActor(source, sourceOffset) || !db.lookupActor(target, targetOffset)) return false;
+  if (sourceOffset == targetOffset)
+  {
+    result = path(source);
+    return true;
+  }
+
+  parallelSide forward(db, sourceOffset);
+  parallelSide backward(db, targetOffset);
+  levelPool pool(max(numThreads, (size_t) 1));
+  while (forward.depth + backward.depth < kMaxPathLength &&
+         forward.frontierSize() > 0 && backward.frontierSize() > 0)
+  {
+    bool expandForward = forward.frontierSize() <= backward.frontierSize();
+    parallelSide& side = expandForward ? forward : backward;
+    const parallelSide& other = expandForward ? backward : forward;
+    size_t depth = side.depth, frontierSize = side.frontierSize(), numKnown = side.discovered.size();
+    auto start = chrono::steady_clock::now();
+    int meeting = expandLevelParallel(db, side, other, pool);
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+    if (stats != NULL)
+    {
+      stats->push_back({expandForward, depth, frontierSize, side.discovered.size() - numKnown, elapsed.count()});
+    }
+    if (meeting == -1) continue;
+
+    int otherMeeting = findDiscovery(other, side.discovered[meeting].actorOffset);
+    int forwardMeeting = expandForward ? meeting : otherMeeting;
+    int backwardMeeting = expandForward ? otherMeeting : meeting;
+    result = path(source);
+    appendPathFromRoot(db, forward.discovered, forwardMeeting, result);
+    appendPathToRoot(db, backward.discovered, backwardMeeting, result);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,150 @@
+#pragma once
+#include "imdb.h"
+#include "path.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Convenience Class: offsetBitmap
+ * -------------------------------
+ * A dense set of record offsets, one bit per possible record.  Every record
+ * in actordata and moviedata starts on a four-byte boundary, so a bitmap
+ * for a file of n bytes needs just n / 32 bytes of storage, and membership
+ * tests and inserts are a shift, a mask, and a load or store.
+ */
+
+class offsetBitmap {
+ public:
+  offsetBitmap(size_t fileSize) : bits((fileSize / 4 + 63) / 64, 0) {}
+
+  /**
+   * Method: insert
+   * --------------
+   * Adds the specified offset to the set.
+   *
+   * @return true if and only if the offset wasn't already present.
+   */
+  bool insert(uint32_t offset) {
+    uint64_t& word = bits[offset / 4 / 64];
+    uint64_t mask = uint64_t(1) << (offset / 4 % 64);
+    if (word & mask) return false;
+    word |= mask;
+    return true;
+  }
+
+  bool contains(uint32_t offset) const {
+    return (bits[offset / 4 / 64] >> (offset / 4 % 64)) & 1;
+  }
+
+ private:
+  std::vector<uint64_t> bits;
+};
+
+/**
+ * Convenience Class: atomicOffsetBitmap
+ * -------------------------------------
+ * An offsetBitmap that any number of threads can insert into at once.  An
+ * insert is an atomic test-and-set of the offset's bit, so when several threads
+ * race to insert the same offset, exactly one of them is told it was new.
+ */
+
+class atomicOffsetBitmap {
+ public:
+  atomicOffsetBitmap(size_t fileSize) : bits(new std::atomic<uint64_t>[(fileSize / 4 + 63) / 64]()) {}
+
+  bool insert(uint32_t offset) {
+    std::atomic<uint64_t>& word = bits[offset / 4 / 64];
+    uint64_t mask = uint64_t(1) << (offset / 4 % 64);
+    if (word.load(std::memory_order_relaxed) & mask) return false; // skip the locked op when we can
+    return (word.fetch_or(mask, std::memory_order_relaxed) & mask) == 0;
+  }
+
+  bool contains(uint32_t offset) const {
+    return (bits[offset / 4 / 64].load(std::memory_order_relaxed) >> (offset / 4 % 64)) & 1;
+  }
+
+ private:
+  std::unique_ptr<std::atomic<uint64_t>[]> bits;
+};
+
+/**
+ * Constant: kMaxPathLength
+ * ------------------------
+ * The longest path (in movies) the search engine is willing to report.
+ */
+static const size_t kMaxPathLength = 7;
+
+/**
+ * Function: countCostars
+ * ----------------------
+ * Returns the number of distinct people the specified player has worked
+ * with (excluding the player), or 0 if the player isn't in the database.
+ */
+size_t countCostars(const imdb& db, const std::string& player);
+
+/**
+ * Function: findShortestPath
+ * --------------------------
+ * Breadth-first searches the actor/movie graph from source for target, returning
+ * true and populating result if the two are connected by at most kMaxPathLength movies.
+ * The search runs entirely on record offsets: visited actors and movies live in
+ * offsetBitmaps, and each discovered actor remembers only the movie and the queue
+ * entry that led to it.  The path itself is built once, after the target has been
+ * found.  Players are explored in credit order and casts in cast order, so ties
+ * between equally short paths are broken the same way every time.
+ *
+ * @param db the imdb being searched.
+ * @param source the player at the front of the path.
+ * @param target the player at the end of the path.
+ * @param result the path to be populated (and left alone if no path exists).
+ * @return true if and only if a path was found.
+ */
+bool findShortestPath(const imdb& db, const std::string& source, const std::string& target, path& result);
+
+/**
+ * Function: findShortestPathBidirectional
+ * ---------------------------------------
+ * Same contract as findShortestPath, except the search grows one frontier out
+ * from source and a second one back from target, always expanding one full level
+ * of whichever frontier is currently smaller, and stops as soon as the two meet.
+ * Each frontier needs only about half the depth of a one-sided search, so it
+ * touches roughly the square root of the number of actors a one-sided search would.
+ * Both searches find a shortest path, though not necessarily the same one when
+ * there are several.
+ */
+bool findShortestPathBidirectional(const imdb& db, const std::string& source, const std::string& target, path& result);
+
+/**
+ * Type: levelStats
+ * ----------------
+ * What findShortestPathParallel reports about each level it expands: which
+ * side it grew, how deep that side was, how many actors were in the frontier,
+ * how many new actors the level discovered, and how long it took.
+ */
+struct levelStats {
+  bool forward;
+  size_t depth;
+  size_t frontierSize;
+  size_t numDiscovered;
+  double milliseconds;
+};
+
+/**
+ * Function: findShortestPathParallel
+ * ----------------------------------
+ * Same contract and strategy as findShortestPathBidirectional, except each level
+ * is expanded by numThreads threads at once.  The frontier is handed out in small
+ * chunks, the visited sets are atomicOffsetBitmaps, and every thread collects its
+ * discoveries privately until the level is done, so the only contention is over
+ * the bitmaps' bits.  Which thread claims an actor first is up to the scheduler,
+ * so when there are several shortest paths, the one reported can vary from run to run.
+ *
+ * @param numThreads the number of threads to expand each level with (the calling
+ *        thread included), which must be at least 1.
+ * @param stats if non-NULL, receives one entry per level expanded.
+ */
+bool findShortestPathParallel(const imdb& db, const std::string& source, const std::string& target, path& result,
+                              size_t numThreads, std::vector<levelStats> *stats = NULL);
@@ -0,0 +1,229 @@
+/**
+ * File: search-server.cc
+ * ----------------------
+ * Long-running six-degrees server.  Rather than re-mapping the data and running a
+ * cold search for every query (as search does), the server builds a compact
+ * actorGraph index once at startup (or maps a previously saved one) and then
+ * answers queries over a socket for as long as it runs.
+ *
+ * The protocol is line-oriented.  A client connects and sends any number of
+ * queries, one per line, each being a source and a target separated by a tab:
+ *
+ *     Kevin Bacon<TAB>Meryl Streep
+ *
+ * The server replies to each with the path (formatted just as search prints it)
+ * or a "No path..." line, followed by a single blank line, and keeps reading
+ * queries until the client closes the connection.  The most recent answers are
+ * kept in an LRU cache, so popular queries are answered without searching at all.
+ *
+ * Each connection is served by its own thread, but the index and cache are shared,
+ * so queries themselves are answered one at a time under a single lock.  Searches
+ * over the index take well under a millisecond, so the lock is rarely contended.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <climits>
+#include <cstring>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <ext/stdio_filebuf.h>
+#include "imdb.h"
+#include "path.h"
+#include "actor-graph.h"
+#include "server-socket.h"
+
+using namespace std;
+using namespace __gnu_cxx; // __gnu_cxx::stdio_filebuf -> stdio_filebuf
+
+static const unsigned short kDefaultPort = 13110;
+static const size_t kDefaultCacheCapacity = 4096;
+static const int kWrongArgumentCount = 1;
+static const int kDatabaseNotFound = 2;
+static const int kServerStartFailure = 3;
+
+/**
+ * Class: answerCache
+ * ------------------
+ * A fixed-capacity least-recently-used cache of query -> answer.  The
+ * list holds entries from most to least recently used, and the map
+ * finds an entry's place in the list in constant time.
+ */
+class answerCache {
+ public:
+  answerCache(size_t capacity) : capacity(capacity) {}
+
+  bool lookup(const string& query, string& answer) {
+    auto found = index.find(query);
+    if (found == index.end()) return false;
+    entries.splice(entries.begin(), entries, found->second);
+    answer = found->second->second;
+    return true;
+  }
+
+  void insert(const string& query, const string& answer) {
+    if (capacity == 0) return;
+    if (index.size() == capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+    entries.emplace_front(query, answer);
+    index[query] = entries.begin();
+  }
+
+ private:
+  size_t capacity;
+  list<pair<string, string>> entries;
+  unordered_map<string, list<pair<string, string>>::iterator> index;
+};
+
+/**
+ * Function: answerQuery
+ * ---------------------
+ * Produces the full response to a single tab-separated query line.
+ */
+static string answerQuery(const imdb& db, actorGraph& graph, const string& query) {
+  size_t tab = query.find('\t');
+  if (tab == string::npos) return "Malformed query: expected <source-actor><TAB><target-actor>\n";
+  string source = query.substr(0, tab), target = query.substr(tab + 1);
+  path result(source);
+  if (!graph.findShortestPath(db, source, target, result)) return "No path could be found between these two actors\n";
+  ostringstream oss;
+  oss << result;
+  return oss.str();
+}
+
+/**
+ * Function: serveClient
+ * ---------------------
+ * Answers every query sent over the supplied client connection, consulting
+ * and updating the cache along the way, and closes the connection once the
+ * client has closed its end.
+ */
+static mutex queryLock;
+static void serveClient(int clientSocket, const imdb& db, actorGraph& graph, answerCache& cache) {
+  stdio_filebuf<char> inbuf(clientSocket, ios::in);
+  istream is(&inbuf);
+  while (true) {
+    string query;
+    getline(is, query);
+    if (is.fail()) break;
+    if (!query.empty() && query.back() == '\r') query.pop_back();
+    auto start = chrono::steady_clock::now();
+    string answer;
+    bool cached;
+    {
+      lock_guard<mutex> lg(queryLock);
+      cached = cache.lookup(query, answer);
+      if (!cached) {
+        answer = answerQuery(db, graph, query);
+        cache.insert(query, answer);
+      }
+    }
+    answer += "\n";
+    size_t numBytesWritten = 0;
+    while (numBytesWritten < answer.size()) {
+      ssize_t count = write(clientSocket, answer.c_str() + numBytesWritten, answer.size() - numBytesWritten);
+      if (count <= 0) return;
+      numBytesWritten += count;
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    lock_guard<mutex> lg(queryLock);
+    cout << (cached ? "[cached] " : "[searched] ") << elapsed.count() << "us" << endl;
+  }
+} // stdio_filebuf destroyed, destructor closes clientSocket
+
+/**
+ * Function: loadGraph
+ * -------------------
+ * Maps the index saved in indexFile if there is one that matches the data,
+ * and otherwise builds it from scratch (saving it to indexFile for next time,
+ * if one was named).
+ */
+static void loadGraph(const imdb& db, actorGraph& graph, const string& indexFile) {
+  auto start = chrono::steady_clock::now();
+  if (!indexFile.empty() && graph.load(indexFile, db)) {
+    cout << "Mapped index from \"" << indexFile << "\"";
+  } else {
+    graph.build(db);
+    cout << "Built index";
+    if (!indexFile.empty()) {
+      if (graph.save(indexFile)) cout << " and saved it to \"" << indexFile << "\"";
+      else cout << " (but couldn't save it to \"" << indexFile << "\")";
+    }
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cout << ": " << graph.getNumActors() << " actors, " << graph.getNumMovies() << " movies, in "
+       << elapsed.count() << " seconds." << endl;
+}
+
+static void printUsage(const char *progname) {
+  cerr << "Usage: " << progname << " [--port <port>] [--index <index-file>] [--cache <capacity>]" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  unsigned short port = kDefaultPort;
+  string indexFile;
+  size_t capacity = kDefaultCacheCapacity;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 == argc) {
+      printUsage(argv[0]);
+      return kWrongArgumentCount;
+    }
+    string flag = argv[i];
+    char *end = NULL;
+    if (flag == "--port") {
+      long value = strtol(argv[i + 1], &end, 0);
+      if (*end != '\0' || value < 1024 || value >= USHRT_MAX) {
+        cerr << "Error: port must be purely numeric and within range [1024, " << USHRT_MAX << ")" << endl;
+        return kWrongArgumentCount;
+      }
+      port = value;
+    } else if (flag == "--index") {
+      indexFile = argv[i + 1];
+    } else if (flag == "--cache") {
+      capacity = strtoul(argv[i + 1], &end, 0);
+      if (*end != '\0') {
+        printUsage(argv[0]);
+        return kWrongArgumentCount;
+      }
+    } else {
+      printUsage(argv[0]);
+      return kWrongArgumentCount;
+    }
+  }
+
+  imdb db(kIMDBDataDirectory);
+  if (!db.good()) {
+    cerr << "Data directory not found!  Aborting..." << endl;
+    return kDatabaseNotFound;
+  }
+
+  actorGraph graph;
+  loadGraph(db, graph, indexFile);
+  answerCache cache(capacity);
+
+  int serverSocket = createServerSocket(port);
+  if (serverSocket == kServerSocketFailure) {
+    cerr << "Error: Could not start server on port " << port << "." << endl;
+    cerr << "Aborting... " << endl;
+    return kServerStartFailure;
+  }
+
+  signal(SIGPIPE, SIG_IGN); // clients that hang up early shouldn't take the server down with them
+  cout << "Server listening on port " << port << "." << endl;
+  while (true) {
+    int clientSocket = accept(serverSocket, NULL, NULL);
+    if (clientSocket == -1) continue;
+    thread(serveClient, clientSocket, cref(db), ref(graph), ref(cache)).detach();
+  }
+
+  return 0;
+}
@@ -1,121 +1,71 @@
 #include <string>
-#include <vector>
 #include "imdb.h"
 #include "imdb-utils.h"
 #include "path.h"
-#include <set>
-#include <list>
-#include <queue>
+#include "search-engine.h"
+#include <cstdlib>
+#include <iomanip>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
-static int getNumCostars(const imdb& db, const string& player)
+/**
+ * Function: printLevelStats
+ * -------------------------
+ * Prints one line per level a parallel search expanded to cerr, so it
+ * doesn't get mixed in with the path itself.
+ */
+static void printLevelStats(const vector<levelStats>& stats, size_t numThreads)
 {
-  vector<film> credits;
-  db.getCredits(player, credits);
-  set<string> costars;
-  for (int i = 0; i < (int) credits.size(); i++)
+  cerr << "Expanded " << stats.size() << " level(s) with " << numThreads << " thread(s):" << endl;
+  cerr << setw(10) << "side" << setw(7) << "depth" << setw(11) << "frontier" << setw(12) << "discovered" << setw(12) << "time" << endl;
+  for (const levelStats& level : stats)
   {
-    const film& movie = credits[i];
-    vector<string> cast;
-    db.getCast(movie, cast);
-    for (int j = 0; j < (int)cast.size(); j++)
-    {
-      const string& costar = cast[j];
-      if (costar != player)
-      {
-        costars.insert(costar);
-      }
-    }
+    cerr << setw(10) << (level.forward ? "forward" : "backward") << setw(7) << level.depth
+         << setw(11) << level.frontierSize << setw(12) << level.numDiscovered
+         << fixed << setprecision(3) << setw(10) << level.milliseconds << "ms" << endl;
   }
-  return costars.size();
 }
-void BFS(const string& start_arg, const string& target_arg)
+
+void BFS(const string& start, const string& target, size_t numThreads)
 {
   imdb db(kIMDBDataDirectory);
-  list<path> queue;
-  bool reversed = false;
-  int startarg_numCostars = getNumCostars(db, start_arg);
-  int targetarg_numCostars = getNumCostars(db, target_arg);
-  string start;
-  string target;
-  if (targetarg_numCostars < startarg_numCostars)
-  {
-    reversed = true;
-    start = target_arg;
-    target = start_arg;
-  }
-  else
+  path result(start);
+  vector<levelStats> stats;
+  bool found = numThreads == 0 ? findShortestPathBidirectional(db, start, target, result) :
+                                 findShortestPathParallel(db, start, target, result, numThreads, &stats);
+  if (numThreads > 0) printLevelStats(stats, numThreads);
+  if (!found)
   {
-    start = start_arg;
-    target = target_arg;
+    cout << "No path could be found between these two actors" << endl;
+    return;
   }
-  set<string> visitedActors;
-  set<film> visitedFilms;
-  path path0 {start};
-  queue.push_back(path0);
-  visitedActors.insert(start);
-  while(!queue.empty())
+  cout << result;
+}
+
+/**
+ * The optional -j <threads> flag switches to the parallel search, which
+ * also reports how each level went.
+ */
+int main(int argc, char *argv[]) {
+  size_t numThreads = 0;
+  if (argc == 5 && string(argv[1]) == "-j")
   {
-    path currpath(queue.front());
-    queue.pop_front();
-    const string& lastPlayer = currpath.getLastPlayer();
-    
-    int numHops = currpath.getLength();
-    
-    if (numHops == 7)
-    {
-      cerr << "No path could be found between these two people." << endl;
-      return;
-    }
-    
-    vector<film> credits;
-    db.getCredits(lastPlayer, credits);
-    for (auto& film_i: credits)
+    char *end;
+    long value = strtol(argv[2], &end, 10);
+    if (*end != '\0' || value < 1)
     {
-      pair<std::set<film>::iterator,bool> ret;
-      ret = visitedFilms.insert(film_i);
-      if (ret.second == false)
-      {
-        continue;
-      }
-      vector<string> cast;
-      db.getCast(film_i, cast);
-      for (auto& actor_i: cast)
-      {
-        pair<std::set<string>::iterator, bool> ret2;
-        ret2 = visitedActors.insert(actor_i);
-        if (ret2.second == false)
-        {
-          continue;
-        }
-        path newpath(currpath);
-        newpath.addConnection(film_i, actor_i);
-        if (actor_i == target)
-        {
-          if(reversed){
-            newpath.reverse();
-          }
-          cout << newpath;
-          return;
-        }   
-         
-        if (newpath.getLength() == 7)
-        {
-          continue;
-        }
-        queue.push_back(newpath);
-      }
+      cout << "The thread count must be a positive integer." << endl;
+      return -1;
     }
+    numThreads = value;
+    argv += 2;
+    argc -= 2;
   }
-  cout << "No path could be found between these two actors" << endl;
-}
-
-int main(int argc, char *argv[]) {
   if (argc != 3)
   {
-    cout << "Usage: slink/search_soln <source-actor> <target-actor>" << endl;
+    cout << "Usage: slink/search_soln [-j <threads>] <source-actor> <target-actor>" << endl;
     return -1;
   }
   const string start(argv[1]);
@@ -125,6 +75,6 @@ int main(int argc, char *argv[]) {
     cout << "Ensure that source and target are different!" << endl;
     return -1;
   }
-  BFS(start, target);
+  BFS(start, target, numThreads);
   return 0;
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "diskimg.h"
 #include "unixfilesystem.h"
@@ -13,41 +14,245 @@
 #include "chksumfile.h"
 #include <openssl/sha.h>
 
-int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum) {
+// The most blocks read (and hashed) at once.
+#define CHKSUMFILE_RUN_BLOCKS 32
+
+/**
+ * The checksum cache remembers, for each inode, the checksum last computed
+ * for it along with a key identifying the inode's contents: a SHA-1 of the
+ * inode itself (access time aside, since reading a file changes it) and of
+ * every indirect block it uses.  If an inode and its indirect blocks still
+ * hash to the same key, the file occupies the same blocks with the same size
+ * and modification time as before, so its old checksum is reused instead of
+ * rehashing the data.  (A block overwritten in place without the inode being
+ * touched would go unnoticed, but the v6 kernel always updates i_mtime.)
+ *
+ * The cache is loaded from and saved to a sidecar file, which records the
+ * identity of the image it describes (its full path, boot block, and
+ * geometry) and is ignored if paired with any other.
+ */
+#define SIDECAR_MAGIC "V6CKSUM1"
+
+struct sidecarheader {
+  char magic[8];
+  uint8_t identity[SHA_DIGEST_LENGTH];
+  uint32_t numEntries;
+};
+
+struct sidecarentry {
+  uint32_t inumber;
+  uint8_t key[SHA_DIGEST_LENGTH];
+  uint8_t chksum[SHA_DIGEST_LENGTH];
+};
+
+struct cacheslot {
+  int valid;
+  uint8_t key[SHA_DIGEST_LENGTH];
+  uint8_t chksum[SHA_DIGEST_LENGTH];
+};
+
+static struct unixfilesystem *cacheFs = NULL;
+static char *sidecarPath = NULL;
+static uint8_t imageIdentity[SHA_DIGEST_LENGTH];
+static struct cacheslot *slots = NULL;  // indexed by inumber
+static int numSlots = 0;
+static long numReused = 0, numComputed = 0;
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Hashes the rest of the file the iterator covers into chksum.
+ */
+static int hash_file(struct file_iterator *it, void *chksum) {
   SHA_CTX shactx;
   if (!SHA1_Init(&shactx)) {
     // An error occurred initializing the SHA1 context.
     return -1;
   }
 
-  struct inode in;
-  int err = inode_iget(fs, inumber, &in);
+  // Stream the file through in runs of physically consecutive blocks, each
+  // read with one call (or hashed in place, if the image is mapped).
+  while (1) {
+    char buf[CHKSUMFILE_RUN_BLOCKS * DISKIMG_SECTOR_SIZE];
+    const void *data;
+    int bytesMoved = file_readnext(it, buf, CHKSUMFILE_RUN_BLOCKS, &data);
+    if (bytesMoved < 0)
+      return -1;
+    if (bytesMoved == 0)
+      break;
+
+    if (!SHA1_Update(&shactx, data, bytesMoved))
+      return -1;
+  }
+
+  if (!SHA1_Final(chksum, &shactx))
+    return -1;
+
+  return SHA_DIGEST_LENGTH;
+}
+
+static int hash_sector(struct unixfilesystem *fs, int sectorNum, SHA_CTX *shactx) {
+  char buf[DISKIMG_SECTOR_SIZE];
+  const void *sector = diskimg_getsector(fs->dfd, sectorNum, buf);
+  if (sector == NULL || !SHA1_Update(shactx, sector, DISKIMG_SECTOR_SIZE)) return -1;
+  return 0;
+}
+
+/**
+ * Computes the cache key for the specified inode: a SHA-1 of the inode
+ * (with its access time zeroed) followed by each indirect block it uses.
+ */
+static int inode_key(struct unixfilesystem *fs, const struct inode *inp, uint8_t *key) {
+  SHA_CTX shactx;
+  struct inode in = *inp;
+  memset(in.i_atime, 0, sizeof(in.i_atime));
+  if (!SHA1_Init(&shactx) || !SHA1_Update(&shactx, &in, sizeof(in))) return -1;
+
+  if (in.i_mode & ILARG) {
+    int numBlocks = (inode_getsize(&in) + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+    int numIndirect = (numBlocks + BLOCKNUMBERSPERBLOCK - 1) / BLOCKNUMBERSPERBLOCK;
+    for (int i = 0; i < numIndirect && i < MAXNUMPAYLOADBLOCKSLEVEL1; i++) {
+      if (hash_sector(fs, in.i_addr[i], &shactx) < 0) return -1;
+    }
+    if (numIndirect > MAXNUMPAYLOADBLOCKSLEVEL1) {
+      uint16_t doubly[BLOCKNUMBERSPERBLOCK];
+      const uint16_t *entries = diskimg_getsector(fs->dfd, in.i_addr[LASTIADDR], doubly);
+      if (entries == NULL || !SHA1_Update(&shactx, entries, DISKIMG_SECTOR_SIZE)) return -1;
+      for (int i = 0; i < numIndirect - MAXNUMPAYLOADBLOCKSLEVEL1; i++) {
+        if (hash_sector(fs, entries[i], &shactx) < 0) return -1;
+      }
+    }
+  }
+
+  return SHA1_Final(key, &shactx) ? 0 : -1;
+}
+
+int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum) {
+  struct file_iterator it;
+  int err = file_iterinit(&it, fs, inumber, 0);
   if (err < 0) {
     return err;
   }
 
-  if (!(in.i_mode & IALLOC)) {
+  if (!(it.in.i_mode & IALLOC)) {
     // The inode isn't allocated, so we can't hash it.
     return -1;
   }
 
-  int size = inode_getsize(&in);
-  for (int offset = 0; offset < size; offset += DISKIMG_SECTOR_SIZE) {
-    char buf[DISKIMG_SECTOR_SIZE];
-    int bno = offset/DISKIMG_SECTOR_SIZE;
+  uint8_t key[SHA_DIGEST_LENGTH];
+  int cached = fs == cacheFs && inumber < numSlots && inode_key(fs, &it.in, key) == 0;
+  if (cached) {
+    pthread_mutex_lock(&cacheLock);
+    int reuse = slots[inumber].valid && memcmp(slots[inumber].key, key, SHA_DIGEST_LENGTH) == 0;
+    if (reuse) {
+      memcpy(chksum, slots[inumber].chksum, SHA_DIGEST_LENGTH);
+      numReused++;
+    }
+    pthread_mutex_unlock(&cacheLock);
+    if (reuse) return SHA_DIGEST_LENGTH;
+  }
 
-    int bytesMoved = file_getblock(fs, inumber, bno, buf);
-    if (bytesMoved < 0)
-      return -1;
+  int length = hash_file(&it, chksum);
+  if (cached && length == SHA_DIGEST_LENGTH) {
+    pthread_mutex_lock(&cacheLock);
+    slots[inumber].valid = 1;
+    memcpy(slots[inumber].key, key, SHA_DIGEST_LENGTH);
+    memcpy(slots[inumber].chksum, chksum, SHA_DIGEST_LENGTH);
+    numComputed++;
+    pthread_mutex_unlock(&cacheLock);
+  }
+  return length;
+}
 
-    if (!SHA1_Update(&shactx, buf, bytesMoved))
-      return -1;
+int chksumfile_opencache(struct unixfilesystem *fs, const char *imagePath, const char *pathname) {
+  // the image's identity: where it lives, its boot block, and the sizes of
+  // its inode table and volume
+  SHA_CTX shactx;
+  char bootblock[DISKIMG_SECTOR_SIZE];
+  char *fullPath = realpath(imagePath, NULL);
+  const char *location = fullPath != NULL ? fullPath : imagePath;
+  int ok = diskimg_readsector(fs->dfd, BOOTBLOCK_SECTOR, bootblock) == DISKIMG_SECTOR_SIZE &&
+    SHA1_Init(&shactx) && SHA1_Update(&shactx, location, strlen(location) + 1);
+  free(fullPath);
+  if (!ok || !SHA1_Update(&shactx, bootblock, sizeof(bootblock)) ||
+      !SHA1_Update(&shactx, &fs->superblock.s_isize, sizeof(fs->superblock.s_isize)) ||
+      !SHA1_Update(&shactx, &fs->superblock.s_fsize, sizeof(fs->superblock.s_fsize)) ||
+      !SHA1_Final(imageIdentity, &shactx)) {
+    return -1;
   }
 
-  if (!SHA1_Final(chksum, &shactx))
+  numSlots = fs->superblock.s_isize * INODESPERBLOCK + ROOT_INUMBER;
+  slots = calloc(numSlots, sizeof(struct cacheslot));
+  sidecarPath = strdup(pathname);
+  if (slots == NULL || sidecarPath == NULL) {
+    free(slots);
+    free(sidecarPath);
+    slots = NULL;
+    sidecarPath = NULL;
+    numSlots = 0;
     return -1;
+  }
+  cacheFs = fs;
 
-  return SHA_DIGEST_LENGTH;
+  // a missing, unreadable, or mismatched sidecar just means starting from scratch
+  FILE *infile = fopen(pathname, "rb");
+  if (infile == NULL) return 0;
+  struct sidecarheader header;
+  if (fread(&header, sizeof(header), 1, infile) == 1 &&
+      memcmp(header.magic, SIDECAR_MAGIC, sizeof(header.magic)) == 0 &&
+      memcmp(header.identity, imageIdentity, SHA_DIGEST_LENGTH) == 0) {
+    for (uint32_t i = 0; i < header.numEntries; i++) {
+      struct sidecarentry entry;
+      if (fread(&entry, sizeof(entry), 1, infile) != 1) break;
+      if (entry.inumber >= (uint32_t) numSlots) continue;
+      slots[entry.inumber].valid = 1;
+      memcpy(slots[entry.inumber].key, entry.key, SHA_DIGEST_LENGTH);
+      memcpy(slots[entry.inumber].chksum, entry.chksum, SHA_DIGEST_LENGTH);
+    }
+  }
+  fclose(infile);
+  return 0;
+}
+
+int chksumfile_savecache(void) {
+  if (cacheFs == NULL) return 0;
+  struct sidecarheader header;
+  memcpy(header.magic, SIDECAR_MAGIC, sizeof(header.magic));
+  memcpy(header.identity, imageIdentity, SHA_DIGEST_LENGTH);
+  header.numEntries = 0;
+  for (int i = 0; i < numSlots; i++) header.numEntries += slots[i].valid;
+
+  // write to a temporary file and rename it into place, so a failed save
+  // never leaves a truncated sidecar behind
+  char tmpPath[strlen(sidecarPath) + 5];
+  sprintf(tmpPath, "%s.tmp", sidecarPath);
+  FILE *outfile = fopen(tmpPath, "wb");
+  int err = outfile == NULL || fwrite(&header, sizeof(header), 1, outfile) != 1;
+  for (int i = 0; i < numSlots && !err; i++) {
+    if (!slots[i].valid) continue;
+    struct sidecarentry entry;
+    entry.inumber = i;
+    memcpy(entry.key, slots[i].key, SHA_DIGEST_LENGTH);
+    memcpy(entry.chksum, slots[i].chksum, SHA_DIGEST_LENGTH);
+    err = fwrite(&entry, sizeof(entry), 1, outfile) != 1;
+  }
+  if (outfile != NULL && fclose(outfile) != 0) err = 1;
+  if (!err && rename(tmpPath, sidecarPath) != 0) err = 1;
+  if (err) unlink(tmpPath);
+
+  free(slots);
+  free(sidecarPath);
+  slots = NULL;
+  sidecarPath = NULL;
+  numSlots = 0;
+  cacheFs = NULL;
+  return err ? -1 : 0;
+}
+
+void chksumfile_getcachestats(long *reused, long *computed) {
+  pthread_mutex_lock(&cacheLock);
+  *reused = numReused;
+  *computed = numComputed;
+  pthread_mutex_unlock(&cacheLock);
 }
 
 int chksumfile_bypathname(struct unixfilesystem *fs, const char *pathname, void *chksum) {
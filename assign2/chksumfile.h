@@ -13,6 +13,28 @@
  */
 int chksumfile_byinumber(struct unixfilesystem *fs, int inumber, void *chksum);
 
+/**
+ * Loads the checksum cache for fs (which was read from the disk image at
+ * imagePath) from the named sidecar file, after which
+ * chksumfile_byinumber reuses the checksum recorded for any inode whose
+ * contents (per its inode and indirect blocks) haven't changed since.  A
+ * missing or mismatched sidecar leaves the cache empty.  Returns 0 on
+ * success, or -1 if the cache couldn't be set up.
+ */
+int chksumfile_opencache(struct unixfilesystem *fs, const char *imagePath, const char *pathname);
+
+/**
+ * Writes the checksum cache back to its sidecar file, replacing the old one,
+ * and then discards it.  Returns 0 on success, or -1 if it couldn't be saved.
+ */
+int chksumfile_savecache(void);
+
+/**
+ * Reports how many checksums the cache let chksumfile_byinumber reuse, and
+ * how many it had to compute (and record), so far.
+ */
+void chksumfile_getcachestats(long *reused, long *computed);
+
 /**
  * Compute the checksum of the specified pathname.  Assumes chksum points to a
  * CHKSUMFILE_SIZE byte array. Returns the length of the checksum or -1 if
@@ -3,47 +3,160 @@
 #include "diskimg.h"
 #include "file.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
-int directory_findname(struct unixfilesystem *fs, const char *name,
-		       int dirinumber, struct direntv6 *dirEnt) {
-  
-  struct inode inp;
+/**
+ * The dentry cache maps (filesystem, directory inumber, name) to the
+ * directory entry found under that name.  The first time a directory is
+ * searched, every one of its entries goes into the cache and the directory
+ * is marked as indexed; from then on, any name that isn't in the cache
+ * under that directory isn't in the directory either, so no lookup in it
+ * ever touches the disk again.  Both tables use open addressing and double
+ * in size whenever they get more than half full.
+ */
+struct dentry {
+  struct unixfilesystem *fs;  // NULL for an empty slot
+  int dirinumber;
+  char name[CAPLENGTH];       // padded with '\0's, so names compare with memcmp
+  struct direntv6 entry;
+};
+
+struct indexeddir {
+  struct unixfilesystem *fs;  // NULL for an empty slot
+  int dirinumber;
+};
+
+static int cacheEnabled = 1;
+static struct dentry *dentries = NULL;
+static int numDentrySlots = 0, numDentries = 0;
+static struct indexeddir *indexed = NULL;
+static int numIndexedSlots = 0, numIndexed = 0;
+static long numHits = 0, numMisses = 0;
+// held for the whole of a cached lookup, scan included, so that two threads
+// missing on the same directory don't both index it
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int dentry_hash(struct unixfilesystem *fs, int dirinumber, const char *key) {
+  unsigned int hash = 2166136261u ^ (unsigned int) (size_t) fs ^ (unsigned int) dirinumber;
+  for (int i = 0; i < CAPLENGTH && key[i] != '\0'; i++) {
+    hash = (hash ^ (unsigned char) key[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Returns the slot holding the specified key, or the empty slot where it
+ * belongs if it isn't there.
+ */
+static struct dentry *dentry_slot(struct dentry *table, int numSlots, struct unixfilesystem *fs,
+                                  int dirinumber, const char *key) {
+  unsigned int i = dentry_hash(fs, dirinumber, key) & (numSlots - 1);
+  while (table[i].fs != NULL &&
+         (table[i].fs != fs || table[i].dirinumber != dirinumber || memcmp(table[i].name, key, CAPLENGTH) != 0)) {
+    i = (i + 1) & (numSlots - 1);
+  }
+  return &table[i];
+}
+
+static struct indexeddir *indexed_slot(struct indexeddir *table, int numSlots, struct unixfilesystem *fs, int dirinumber) {
+  unsigned int i = ((unsigned int) dirinumber * 2654435761u) & (numSlots - 1);
+  while (table[i].fs != NULL && (table[i].fs != fs || table[i].dirinumber != dirinumber)) {
+    i = (i + 1) & (numSlots - 1);
+  }
+  return &table[i];
+}
+
+/**
+ * Makes sure there's room for one more dentry, returning -1 if
+ * memory has run out.
+ */
+static int dentry_reserve(void) {
+  if (2 * (numDentries + 1) <= numDentrySlots) return 0;
+  int numSlots = numDentrySlots == 0 ? 1024 : 2 * numDentrySlots;
+  struct dentry *table = calloc(numSlots, sizeof(struct dentry));
+  if (table == NULL) return -1;
+  for (int i = 0; i < numDentrySlots; i++) {
+    if (dentries[i].fs == NULL) continue;
+    *dentry_slot(table, numSlots, dentries[i].fs, dentries[i].dirinumber, dentries[i].name) = dentries[i];
+  }
+  free(dentries);
+  dentries = table;
+  numDentrySlots = numSlots;
+  return 0;
+}
+
+static int indexed_reserve(void) {
+  if (2 * (numIndexed + 1) <= numIndexedSlots) return 0;
+  int numSlots = numIndexedSlots == 0 ? 64 : 2 * numIndexedSlots;
+  struct indexeddir *table = calloc(numSlots, sizeof(struct indexeddir));
+  if (table == NULL) return -1;
+  for (int i = 0; i < numIndexedSlots; i++) {
+    if (indexed[i].fs == NULL) continue;
+    *indexed_slot(table, numSlots, indexed[i].fs, indexed[i].dirinumber) = indexed[i];
+  }
+  free(indexed);
+  indexed = table;
+  numIndexedSlots = numSlots;
+  return 0;
+}
+
+/**
+ * Adds an entry read from the specified directory to the cache, unless an
+ * earlier entry with the same name got there first (directory_findname
+ * reports the first match).  Returns -1 if memory has run out.
+ */
+static int dentry_insert(struct unixfilesystem *fs, int dirinumber, const struct direntv6 *d) {
+  char key[CAPLENGTH];
+  strncpy(key, d->d_name, CAPLENGTH);
+  if (dentry_reserve() < 0) return -1;
+  struct dentry *slot = dentry_slot(dentries, numDentrySlots, fs, dirinumber, key);
+  if (slot->fs != NULL) return 0;
+  slot->fs = fs;
+  slot->dirinumber = dirinumber;
+  memcpy(slot->name, key, CAPLENGTH);
+  slot->entry = *d;
+  numDentries++;
+  return 0;
+}
+
+/**
+ * Scans the specified directory for name.  If index is set, the scan covers
+ * the whole directory, adding every entry to the dentry cache as it goes and
+ * marking the directory as indexed at the end (unless memory runs out, in
+ * which case it's simply left unindexed).
+ */
+static int scan_directory(struct unixfilesystem *fs, const char *name,
+                          int dirinumber, struct direntv6 *dirEnt, int index) {
+  struct file_iterator it;
+  int found = 0;
   
-  int getflag = inode_iget(fs, dirinumber, &inp);
-  if(getflag == ERROR || ((inp.i_mode & IFMT) != IFDIR))
+  int getflag = file_iterinit(&it, fs, dirinumber, 0);
+  if(getflag == ERROR || ((it.in.i_mode & IFMT) != IFDIR))
   {
     printf("Failed to access directory\n");
     return ERROR;
   }
-  
-  //find how many bytes are in the file
-  int file_bytes = inode_getsize(&inp);
-  
-  // find how many blocks are in the file
-  int num_dirblocks = file_bytes / DISKIMG_SECTOR_SIZE;
-  
-  // find how many bytes are in the last unfilled block
-  int remainder = file_bytes % DISKIMG_SECTOR_SIZE;
-  if (remainder != 0)
-  {
-    num_dirblocks++;
-  }
 
   // for each block that contains payload, get the block and check if the
-  // string is in one of the entries contained in the directory block
-
-  for (int payblock_i = 0; payblock_i < num_dirblocks; payblock_i++)
+  // string is in one of the entries contained in the directory block.  The
+  // iterator fetches the directory's inode just once, and the blocks are
+  // scanned in place when the image is mapped
+  while (1)
   {
     char buf[DISKIMG_SECTOR_SIZE];
-    int numreadbytes = file_getblock(fs, dirinumber, payblock_i, buf);
+    const void *data;
+    int numreadbytes = file_readnext(&it, buf, 1, &data);
     
     if (numreadbytes == ERROR)
     {
       printf("ReadError!\n");
       return ERROR;
     }
+    if (numreadbytes == 0) break;
+    const char *block = data;
 
     // find how many directory entries are stored in the block
     int numdirentries = numreadbytes / BLOCKNUMPERBLOCK;
@@ -54,15 +167,59 @@ int directory_findname(struct unixfilesystem *fs, const char *name,
     }
     
     for (int i = 0; i < numdirentries; ++i) {
-      struct direntv6 *d = (struct direntv6 *)(buf + i*(sizeof(struct direntv6)));
-      if (strncmp(d->d_name, name, CAPLENGTH)== 0)
+      const struct direntv6 *d = (const struct direntv6 *)(block + i*(sizeof(struct direntv6)));
+      if (index && dentry_insert(fs, dirinumber, d) < 0) index = 0;
+      if (!found && strncmp(d->d_name, name, CAPLENGTH)== 0)
       {
         //if found, return the directory entry in space addressed by
         //dirEnt.
         *dirEnt = *d;
-        return 0;
+        found = 1;
+        if (!index) return 0;
       }
     }
   }
-  return NOTFOUND;    
+  if (index && indexed_reserve() == 0) {
+    struct indexeddir *slot = indexed_slot(indexed, numIndexedSlots, fs, dirinumber);
+    slot->fs = fs;
+    slot->dirinumber = dirinumber;
+    numIndexed++;
+  }
+  return found ? 0 : NOTFOUND;    
+}
+
+int directory_findname(struct unixfilesystem *fs, const char *name,
+		       int dirinumber, struct direntv6 *dirEnt) {
+  if (!cacheEnabled) return scan_directory(fs, name, dirinumber, dirEnt, 0);
+
+  char key[CAPLENGTH];
+  strncpy(key, name, CAPLENGTH);
+  pthread_mutex_lock(&cacheLock);
+  int result;
+  struct dentry *slot = numDentrySlots > 0 ? dentry_slot(dentries, numDentrySlots, fs, dirinumber, key) : NULL;
+  if (slot != NULL && slot->fs != NULL) {
+    numHits++;
+    *dirEnt = slot->entry;
+    result = 0;
+  } else if (numIndexedSlots > 0 && indexed_slot(indexed, numIndexedSlots, fs, dirinumber)->fs != NULL) {
+    // the whole directory is in the cache, and name isn't in it
+    numHits++;
+    result = NOTFOUND;
+  } else {
+    numMisses++;
+    result = scan_directory(fs, name, dirinumber, dirEnt, 1);
+  }
+  pthread_mutex_unlock(&cacheLock);
+  return result;
+}
+
+void directory_setcache(int enabled) {
+  cacheEnabled = enabled;
+}
+
+void directory_getcachestats(long *hits, long *misses) {
+  pthread_mutex_lock(&cacheLock);
+  *hits = numHits;
+  *misses = numMisses;
+  pthread_mutex_unlock(&cacheLock);
 }
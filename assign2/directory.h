@@ -16,4 +16,19 @@
 int directory_findname(struct unixfilesystem *fs, const char *name,
                        int dirinumber, struct direntv6 *dirEnt);
 
+/**
+ * directory_findname keeps a cache of the directory entries it has seen,
+ * and indexes a whole directory the first time it's searched, so repeated
+ * lookups (pathname_lookup resolving paths that share a prefix, say) never
+ * rescan a directory.  The cache is on by default; passing 0 turns it off.
+ * The filesystem is assumed not to change underneath it.
+ */
+void directory_setcache(int enabled);
+
+/**
+ * Reports how many directory_findname calls the cache answered (hits) and
+ * how many had to scan a directory (misses) so far.
+ */
+void directory_getcachestats(long *hits, long *misses);
+
 #endif // _DIECTORY_H_
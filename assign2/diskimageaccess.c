@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <string.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "diskimg.h"
 #include "unixfilesystem.h"
@@ -16,16 +18,22 @@
 int quietFlag = 0; 
 int idumpFlag = 0;
 int pdumpFlag = 0;
+int mapFlag = 0;
+int cacheSectors = DISKIMG_DEFAULT_CACHE_SECTORS;
+int numThreads = 1;
+char *sidecarPath = NULL;
 
 static void PrintDirectory(struct unixfilesystem *fs,  char *pathname);
 static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f);
 static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f);
+static void DumpInodeChecksumParallel(struct unixfilesystem *fs, FILE *f);
+static void DumpPathnameChecksumParallel(struct unixfilesystem *fs, FILE *f);
 static void PrintUsageAndExit(char *progname);
 static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6 *entries, int maxNumEntries);
 
 int main(int argc, char *argv[]) {
   int opt;
-  while ((opt = getopt(argc, argv, "iqp")) != -1) {
+  while ((opt = getopt(argc, argv, "iqpmdc:j:s:")) != -1) {
     switch (opt) {
     case 'q':
       quietFlag = 1;
@@ -36,6 +44,22 @@ int main(int argc, char *argv[]) {
     case 'p':
       pdumpFlag = 1;
       break;
+    case 'm':
+      mapFlag = 1;
+      break;
+    case 'd':
+      directory_setcache(0);
+      break;
+    case 'c':
+      cacheSectors = atoi(optarg);
+      break;
+    case 's':
+      sidecarPath = optarg;
+      break;
+    case 'j':
+      numThreads = atoi(optarg);
+      if (numThreads < 1) PrintUsageAndExit(argv[0]);
+      break;
     default: 
       PrintUsageAndExit(argv[0]);
     } 
@@ -45,6 +69,10 @@ int main(int argc, char *argv[]) {
     PrintUsageAndExit(argv[0]);
   }
 
+  if (diskimg_setcachesize(cacheSectors) < 0) {
+    fprintf(stderr, "Can't allocate a %d-sector cache, running without one\n", cacheSectors);
+  }
+
   char *diskpath = argv[optind];
   int fd = diskimg_open(diskpath, 1);
 
@@ -53,6 +81,12 @@ int main(int argc, char *argv[]) {
     exit(EXIT_FAILURE);
   }
 
+  if (mapFlag && diskimg_map(fd) < 0) {
+    fprintf(stderr, "Can't map diskimagePath %s\n", diskpath);
+    (void) diskimg_close(fd);
+    exit(EXIT_FAILURE);
+  }
+
   struct unixfilesystem *fs = unixfilesystem_init(fd);
   if (!fs) {
     fprintf(stderr, "Failed to initialize unix filesystem\n");
@@ -62,25 +96,60 @@ int main(int argc, char *argv[]) {
   if (!quietFlag) {  
     int disksize = diskimg_getsize(fd);
     if (disksize < 0) {
-      fprintf(stderr, "Error getting the size of %s\n", argv[1]);
+      fprintf(stderr, "Error getting the size of %s\n", diskpath);
       // Cast the result of diskimg_close to void so the compiler doesn't
       // complain that we're ignoring its return value.
       (void) diskimg_close(fd);
       free(fs);
       exit(EXIT_FAILURE);
     }
-    printf("Disk %s is %d bytes (%d KB)\n", argv[1],  disksize, disksize/1024);
+    printf("Disk %s is %d bytes (%d KB)\n", diskpath,  disksize, disksize/1024);
     printf("Superblock s_isize %d\n",(int)fs->superblock.s_isize);
     printf("Superblock s_fsize %d\n",(int)fs->superblock.s_fsize);
     printf("Superblock s_nfree %d\n",(int)fs->superblock.s_nfree);
     printf("Superblock s_ninode %d\n",(int)fs->superblock.s_ninode);
   }
 
-  if (idumpFlag) DumpInodeChecksum(fs, stdout);
-  if (pdumpFlag) DumpPathnameChecksum(fs, stdout);
+  if (sidecarPath != NULL && chksumfile_opencache(fs, diskpath, sidecarPath) < 0) {
+    fprintf(stderr, "Can't set up the checksum cache, computing every checksum\n");
+  }
+
+  if (idumpFlag) {
+    if (numThreads > 1) DumpInodeChecksumParallel(fs, stdout);
+    else DumpInodeChecksum(fs, stdout);
+  }
+  if (pdumpFlag) {
+    if (numThreads > 1) DumpPathnameChecksumParallel(fs, stdout);
+    else DumpPathnameChecksum(fs, stdout);
+  }
+
+  if (sidecarPath != NULL) {
+    if (chksumfile_savecache() < 0) fprintf(stderr, "Can't save the checksum cache to %s\n", sidecarPath);
+    if (!quietFlag) {
+      long reused, computed;
+      chksumfile_getcachestats(&reused, &computed);
+      printf("Checksum cache: %ld reused, %ld computed\n", reused, computed);
+    }
+  }
+
+  if (!quietFlag && !mapFlag) {
+    long hits, misses;
+    diskimg_getcachestats(&hits, &misses);
+    printf("Sector cache (%d sectors): %ld hits, %ld misses", cacheSectors, hits, misses);
+    if (hits + misses > 0) printf(" (%.1f%% hit rate)", 100.0 * hits / (hits + misses));
+    printf("\n");
+  }
+
+  if (!quietFlag) {
+    long hits, misses;
+    directory_getcachestats(&hits, &misses);
+    printf("Dentry cache: %ld hits, %ld misses", hits, misses);
+    if (hits + misses > 0) printf(" (%.1f%% hit rate)", 100.0 * hits / (hits + misses));
+    printf("\n");
+  }
 
   int err = diskimg_close(fd);
-  if (err < 0) fprintf(stderr, "Error closing %s\n", argv[1]);
+  if (err < 0) fprintf(stderr, "Error closing %s\n", diskpath);
   free(fs);
   exit(EXIT_SUCCESS);
   return 0;
@@ -92,29 +161,30 @@ int main(int argc, char *argv[]) {
  * This is used by the grading script, so be careful not to change its output
  * format.
  */
-static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f) {
-  for (int inumber = 1; inumber < fs->superblock.s_isize*16; inumber++) {
-    struct inode in;
-    if (inode_iget(fs, inumber, &in) < 0) {
-      fprintf(stderr,"Can't read inode %d \n", inumber);
-      return;
-    }
-    if ((in.i_mode & IALLOC) == 0) {
-      // Skip this inode if it's not allocated.
-      continue;
-    }
+static int DumpOneInodeChecksum(struct unixfilesystem *fs, int inumber, const struct inode *inp, void *aux) {
+  FILE *f = aux;
+  // the dump has always stopped one short of the last inode in the table
+  if (inumber >= fs->superblock.s_isize*16) return 1;
+
+  char chksum[CHKSUMFILE_SIZE];
+  if (chksumfile_byinumber(fs, inumber, chksum) < 0) {
+    fprintf(stderr, "Inode %d can't compute chksum\n", inumber);
+    return 0;
+  }
 
-    char chksum[CHKSUMFILE_SIZE];
-    if (chksumfile_byinumber(fs, inumber, chksum) < 0) {
-      fprintf(stderr, "Inode %d can't compute chksum\n", inumber);
-      continue;
-    }
+  char chksumstring[CHKSUMFILE_STRINGSIZE];
+  chksumfile_cvt2string(chksum, chksumstring);
 
-    char chksumstring[CHKSUMFILE_STRINGSIZE];
-    chksumfile_cvt2string(chksum, chksumstring);
+  int size = inode_getsize(inp);
+  fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n",inumber,inp->i_mode, size, chksumstring);
+  return 0;
+}
 
-    int size = inode_getsize(&in);
-    fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n",inumber,in.i_mode, size, chksumstring);
+static void DumpInodeChecksum(struct unixfilesystem *fs, FILE *f) {
+  // inode_scan reads the inode table in big chunks and skips the
+  // unallocated inodes for us
+  if (inode_scan(fs, DumpOneInodeChecksum, f) < 0) {
+    fprintf(stderr,"Can't read the inode table\n");
   }
 }
 
@@ -193,6 +263,310 @@ static void DumpPathnameChecksum(struct unixfilesystem *fs, FILE *f) {
   DumpPathAndChildren(fs, "/", ROOT_INUMBER, f);
 }
 
+/**
+ * The parallel dumps work in three phases.  The files to checksum are listed
+ * first, on the main thread.  Then numThreads workers pull jobs off the list a
+ * few at a time and compute the checksums, sharing the one unixfilesystem (the
+ * diskimg and directory caches are thread-safe).  Finally the main thread
+ * prints the results in the order the sequential dumps visit them, so the
+ * output is identical to the sequential dump's.
+ *
+ * The pathname dump goes through the first two phases once per level of the
+ * directory tree, since the sequential dump only descends into a directory
+ * once its own checksums have come out right, and any lookup of a path below
+ * one that didn't would print errors the sequential dump never does.
+ */
+enum { JOB_PENDING, JOB_OK, JOB_NOINODE, JOB_NOCHKSUM, JOB_DIFFERS };
+
+struct dumpjob {
+  int inumber;
+  char *pathname;  // NULL in an inode dump
+  int firstChild;  // in a pathname dump, a directory's entries get consecutive
+  int numChildren; // jobs, in directory order, once its own job has come out JOB_OK
+  struct inode in;
+  int status;
+  char chksum[CHKSUMFILE_SIZE];
+};
+
+struct dumpqueue {
+  struct unixfilesystem *fs;
+  struct dumpjob *jobs;
+  int numJobs;
+  int nextJob;
+  pthread_mutex_t lock;
+};
+
+struct dumpworker {
+  pthread_t tid;
+  struct dumpqueue *queue;
+  int numFiles;
+  long numBytes;   // sizes of the files checksummed
+  double seconds;
+};
+
+// jobs claimed at a time, so big files don't all land on one worker
+#define DUMP_JOBS_PER_CLAIM 4
+
+static double Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct dumpjob *AddJob(struct dumpqueue *queue, int *capacity) {
+  if (queue->numJobs == *capacity) {
+    *capacity = *capacity == 0 ? 256 : 2 * *capacity;
+    queue->jobs = realloc(queue->jobs, *capacity * sizeof(struct dumpjob));
+    if (queue->jobs == NULL) {
+      fprintf(stderr, "Out of memory.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  struct dumpjob *job = &queue->jobs[queue->numJobs++];
+  memset(job, 0, sizeof(*job));
+  job->status = JOB_PENDING;
+  return job;
+}
+
+static void ComputeJob(struct unixfilesystem *fs, struct dumpjob *job, struct dumpworker *worker) {
+  if (chksumfile_byinumber(fs, job->inumber, job->chksum) < 0) {
+    job->status = JOB_NOCHKSUM;
+    return;
+  }
+  worker->numBytes += inode_getsize(&job->in);
+  if (job->pathname != NULL) {
+    char chksum[CHKSUMFILE_SIZE];
+    if (chksumfile_bypathname(fs, job->pathname, chksum) < 0) {
+      job->status = JOB_NOCHKSUM;
+      return;
+    }
+    if (!chksumfile_compare(job->chksum, chksum)) {
+      job->status = JOB_DIFFERS;
+      return;
+    }
+  }
+  job->status = JOB_OK;
+}
+
+static void *DumpWorker(void *arg) {
+  struct dumpworker *worker = arg;
+  struct dumpqueue *queue = worker->queue;
+  double start = Now();
+  while (1) {
+    pthread_mutex_lock(&queue->lock);
+    int first = queue->nextJob;
+    queue->nextJob += DUMP_JOBS_PER_CLAIM;
+    pthread_mutex_unlock(&queue->lock);
+    if (first >= queue->numJobs) break;
+    int last = first + DUMP_JOBS_PER_CLAIM;
+    if (last > queue->numJobs) last = queue->numJobs;
+    for (int i = first; i < last; i++) {
+      if (queue->jobs[i].status != JOB_PENDING) continue;
+      ComputeJob(queue->fs, &queue->jobs[i], worker);
+      worker->numFiles++;
+    }
+  }
+  worker->seconds += Now() - start;
+  return NULL;
+}
+
+/**
+ * Runs every pending job in the queue from queue->nextJob on across
+ * numThreads threads, adding what each thread did to its entry in workers.
+ */
+static void RunJobs(struct dumpqueue *queue, struct dumpworker workers[]) {
+  pthread_mutex_init(&queue->lock, NULL);
+  for (int i = 0; i < numThreads; i++) {
+    workers[i].queue = queue;
+    if (pthread_create(&workers[i].tid, NULL, DumpWorker, &workers[i]) != 0) {
+      // make do with the threads we have (or with this one, if none started)
+      workers[i].tid = pthread_self();
+      DumpWorker(&workers[i]);
+    }
+  }
+  for (int i = 0; i < numThreads; i++) {
+    if (!pthread_equal(workers[i].tid, pthread_self())) pthread_join(workers[i].tid, NULL);
+  }
+  pthread_mutex_destroy(&queue->lock);
+}
+
+/**
+ * Reports how each of the threads fared (unless -q was given).  The figures change
+ * from run to run, so they go to stderr, leaving stdout comparable with the output
+ * of a single-threaded run.
+ */
+static void ReportWorkers(struct dumpworker workers[], const char *label) {
+  if (!quietFlag) {
+    for (int i = 0; i < numThreads; i++) {
+      double mb = workers[i].numBytes / (1024.0 * 1024.0);
+      fprintf(stderr, "%s worker %d: %d files, %.1f MB in %.3f s", label, i, workers[i].numFiles, mb, workers[i].seconds);
+      if (workers[i].seconds > 0) fprintf(stderr, " (%.1f MB/s)", mb / workers[i].seconds);
+      fprintf(stderr, "\n");
+    }
+  }
+}
+
+static void FreeJobs(struct dumpqueue *queue) {
+  for (int i = 0; i < queue->numJobs; i++) free(queue->jobs[i].pathname);
+  free(queue->jobs);
+}
+
+struct jobcollector {
+  struct dumpqueue *queue;
+  int *capacity;
+};
+
+static int CollectInode(struct unixfilesystem *fs, int inumber, const struct inode *inp, void *aux) {
+  struct jobcollector *collector = aux;
+  if (inumber >= fs->superblock.s_isize*16) return 1; // as in DumpOneInodeChecksum
+  struct dumpjob *job = AddJob(collector->queue, collector->capacity);
+  job->inumber = inumber;
+  job->in = *inp;
+  return 0;
+}
+
+/**
+ * Same output as DumpInodeChecksum, computed with numThreads threads.
+ */
+static void DumpInodeChecksumParallel(struct unixfilesystem *fs, FILE *f) {
+  struct dumpqueue queue;
+  memset(&queue, 0, sizeof(queue));
+  queue.fs = fs;
+  int capacity = 0;
+  struct jobcollector collector = { &queue, &capacity };
+  int unreadable = inode_scan(fs, CollectInode, &collector) < 0;
+
+  struct dumpworker workers[numThreads];
+  memset(workers, 0, sizeof(workers));
+  RunJobs(&queue, workers);
+  ReportWorkers(workers, "Inode dump");
+
+  for (int i = 0; i < queue.numJobs; i++) {
+    struct dumpjob *job = &queue.jobs[i];
+    if (job->status != JOB_OK) {
+      fprintf(stderr, "Inode %d can't compute chksum\n", job->inumber);
+      continue;
+    }
+    char chksumstring[CHKSUMFILE_STRINGSIZE];
+    chksumfile_cvt2string(job->chksum, chksumstring);
+    int size = inode_getsize(&job->in);
+    fprintf(f, "Inode %d mode 0x%x size %d checksum %s\n", job->inumber, job->in.i_mode, size, chksumstring);
+  }
+  if (unreadable) fprintf(stderr,"Can't read the inode table\n");
+  FreeJobs(&queue);
+}
+
+/**
+ * Adds a job for the specified path, which is left pending unless its
+ * inode can't be read.
+ */
+static void AddPathJob(struct unixfilesystem *fs, const char *pathname, int inumber,
+                       struct dumpqueue *queue, int *capacity) {
+  struct dumpjob *job = AddJob(queue, capacity);
+  job->inumber = inumber;
+  job->pathname = strdup(pathname);
+  if (inode_iget(fs, inumber, &job->in) < 0) {
+    job->status = JOB_NOINODE;
+    return;
+  }
+  assert(job->in.i_mode & IALLOC);
+}
+
+/**
+ * Adds jobs for the entries of the directory at the specified job, in the
+ * order DumpPathAndChildren visits them, provided the directory's own
+ * job came out JOB_OK (which is the only way it would have been reached).
+ */
+static void ExpandDirectory(struct unixfilesystem *fs, int index, struct dumpqueue *queue, int *capacity) {
+  if (queue->jobs[index].status != JOB_OK || (queue->jobs[index].in.i_mode & IFMT) != IFDIR) return;
+  int inumber = queue->jobs[index].inumber;
+  const char *pathname = queue->jobs[index].pathname;
+  if (pathname[1] == 0) {
+    /* pathame == "/" */
+    pathname++; /* Delete extra / character */
+  }
+
+  const unsigned int MAXPATH = 1024;
+  struct direntv6 direntries[10000];
+  int numentries = GetDirEntries(fs, inumber, direntries, 10000);
+  int firstChild = queue->numJobs;
+  for (int i = 0; i < numentries; i++) {
+    char *n =  direntries[i].d_name;
+    if (n[0] == '.') {
+      if ((n[1] == 0) || ((n[1] == '.') && (n[2] == 0))) {
+        /* Skip over "." and ".." */
+        continue;
+      }
+    }
+
+    char nextpath[MAXPATH];
+    sprintf(nextpath, "%s/%s",pathname, direntries[i].d_name);
+    AddPathJob(fs, nextpath, direntries[i].d_inumber, queue, capacity); // may move queue->jobs
+  }
+  queue->jobs[index].firstChild = firstChild;
+  queue->jobs[index].numChildren = queue->numJobs - firstChild;
+}
+
+/**
+ * Prints the results for the specified job and everything below it,
+ * just as DumpPathAndChildren would have.
+ */
+static void PrintPathJob(struct dumpqueue *queue, int index, FILE *f) {
+  struct dumpjob *job = &queue->jobs[index];
+  switch (job->status) {
+  case JOB_NOINODE:
+    fprintf(stderr,"Can't read inode %d \n", job->inumber);
+    return;
+  case JOB_NOCHKSUM:
+    fprintf(stderr,"Can't checksum inode %d path %s\n", job->inumber, job->pathname);
+    return;
+  case JOB_DIFFERS:
+    fprintf(stderr,"Pathname checksum of %s differs from inode %d\n", job->pathname, job->inumber);
+    return;
+  }
+
+  char chksumstring[CHKSUMFILE_STRINGSIZE];
+  chksumfile_cvt2string(job->chksum, chksumstring);
+  int size = inode_getsize(&job->in);
+  fprintf(f, "Path %s %d mode 0x%x size %d checksum %s\n", job->pathname, job->inumber, job->in.i_mode, size, chksumstring);
+
+  const char *pathname = job->pathname;
+  if (pathname[1] == 0) pathname++;
+  const unsigned int MAXPATH = 1024;
+  if ((job->in.i_mode & IFMT) == IFDIR && strlen(pathname) > MAXPATH-16) {
+    fprintf(stderr, "Too deep of directories %s\n", pathname);
+  }
+  for (int i = 0; i < job->numChildren; i++) PrintPathJob(queue, job->firstChild + i, f);
+}
+
+/**
+ * Same output as DumpPathnameChecksum, computed with numThreads threads.
+ * Each pass checksums one level of the tree, and the next level is made up
+ * of the entries of just those directories that checked out.
+ */
+static void DumpPathnameChecksumParallel(struct unixfilesystem *fs, FILE *f) {
+  struct dumpqueue queue;
+  memset(&queue, 0, sizeof(queue));
+  queue.fs = fs;
+  int capacity = 0;
+  AddPathJob(fs, "/", ROOT_INUMBER, &queue, &capacity);
+
+  struct dumpworker workers[numThreads];
+  memset(workers, 0, sizeof(workers));
+  int levelStart = 0;
+  while (levelStart < queue.numJobs) {
+    int levelEnd = queue.numJobs;
+    queue.nextJob = levelStart;
+    RunJobs(&queue, workers);
+    for (int i = levelStart; i < levelEnd; i++) ExpandDirectory(fs, i, &queue, &capacity);
+    levelStart = levelEnd;
+  }
+  ReportWorkers(workers, "Pathname dump");
+
+  PrintPathJob(&queue, 0, f);
+  FreeJobs(&queue);
+}
+
 /**
  * Print all the entries in the specified directory. 
  */
@@ -234,25 +608,19 @@ static int GetDirEntries(struct unixfilesystem *fs, int inumber, struct direntv6
 
   assert((size % sizeof(struct direntv6)) == 0);
 
-  int count = 0;
-  int numBlocks  = (size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
-  char buf[DISKIMG_SECTOR_SIZE];
-  struct direntv6 *dir = (struct direntv6 *) buf;
-  for (int bno = 0; bno < numBlocks; bno++) {
-    int bytesLeft, numEntriesInBlock, i;
-    bytesLeft = file_getblock(fs, inumber,bno,dir);
-    if (bytesLeft < 0) {
-      fprintf(stderr, "Error reading directory\n");
-      return -1;
-    }
-    numEntriesInBlock = bytesLeft/sizeof(struct direntv6); 
-    for (i = 0; i <  numEntriesInBlock ; i++) { 
-      entries[count] = dir[i];
-      count++;
-      if (count >= maxNumEntries) return count;
-    }
+  // the entries are laid out back to back, so read as many as fit in one go
+  int numBytes = size;
+  if (numBytes > maxNumEntries * (int) sizeof(struct direntv6)) numBytes = maxNumEntries * sizeof(struct direntv6);
+  int bytesMoved = file_readrange(fs, inumber, 0, numBytes, entries);
+  if (bytesMoved < 0) {
+    fprintf(stderr, "Error reading directory\n");
+    return -1;
   }
-  return count;
+  int numEntries = bytesMoved / sizeof(struct direntv6);
+  // names take up all 14 bytes without a terminator, and the callers print them
+  // with %s, so make sure what follows the last one is a zero rather than stale stack
+  if (numEntries < maxNumEntries) memset(&entries[numEntries], 0, sizeof(struct direntv6));
+  return numEntries;
 }
 
 
@@ -262,5 +630,10 @@ static void PrintUsageAndExit(char *progname) {
   fprintf(stderr, "-q     don't print extra info\n"); 
   fprintf(stderr, "-i     print all inode checksums\n"); 
   fprintf(stderr, "-p     print all pathname checksums\n");  
+  fprintf(stderr, "-m     read the disk image through a read-only memory mapping\n");
+  fprintf(stderr, "-s F   reuse checksums of unchanged files recorded in sidecar file F, and update it\n");
+  fprintf(stderr, "-j N   compute checksums with N threads\n");
+  fprintf(stderr, "-d     don't cache directory entries\n");
+  fprintf(stderr, "-c N   cache up to N disk sectors (default %d, 0 for none)\n", DISKIMG_DEFAULT_CACHE_SECTORS);
   exit(EXIT_FAILURE);
 }
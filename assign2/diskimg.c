@@ -1,10 +1,123 @@
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "diskimg.h"
 
+/**
+ * The sector cache.  Entries live in one flat array; the ones in use are
+ * threaded onto a doubly linked list in order of use (most recent at the
+ * head) and onto the hash chains used to find them, both by array index
+ * rather than by pointer.  Sectors are keyed by descriptor as well as by
+ * number, since more than one image can be open at a time.
+ */
+struct cacheentry {
+  int fd;
+  int sectorNum;
+  int prev, next;   // neighbors in the LRU list, -1 at either end
+  int chain;        // next entry in the same hash bucket, -1 at the end
+  char data[DISKIMG_SECTOR_SIZE];
+};
+
+static struct cacheentry *entries = NULL;
+static int *buckets = NULL;
+static int numBuckets = 0;
+static int capacity = DISKIMG_DEFAULT_CACHE_SECTORS;
+static int numUsed = 0;
+static int head = -1, tail = -1;
+static long numHits = 0, numMisses = 0;
+static pthread_mutex_t cacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// the one image mapped by diskimg_map, if any
+static int mappedFd = -1;
+static char *mappedImage = NULL;
+static size_t mappedSize = 0;
+
+static int cache_bucket(int fd, int sectorNum) {
+  return (unsigned int) (sectorNum * 2654435761u + fd) & (numBuckets - 1);
+}
+
+static void cache_reset(void) {
+  numUsed = 0;
+  head = tail = -1;
+  for (int i = 0; i < numBuckets; i++) buckets[i] = -1;
+}
+
+/**
+ * Allocates the cache's storage the first time it's needed, so programs
+ * that call diskimg_setcachesize before reading anything never allocate
+ * the default.  Returns 0 if the cache is usable, or -1 if it's off.
+ */
+static int cache_init(void) {
+  if (entries != NULL) return 0;
+  if (capacity == 0) return -1;
+  numBuckets = 1;
+  while (numBuckets < 2 * capacity) numBuckets *= 2;
+  entries = malloc(capacity * sizeof(struct cacheentry));
+  buckets = malloc(numBuckets * sizeof(int));
+  if (entries == NULL || buckets == NULL) {
+    free(entries);
+    free(buckets);
+    entries = NULL;
+    buckets = NULL;
+    capacity = 0;
+    return -1;
+  }
+  cache_reset();
+  return 0;
+}
+
+static void lru_unlink(int e) {
+  if (entries[e].prev != -1) entries[entries[e].prev].next = entries[e].next;
+  else head = entries[e].next;
+  if (entries[e].next != -1) entries[entries[e].next].prev = entries[e].prev;
+  else tail = entries[e].prev;
+}
+
+static void lru_pushfront(int e) {
+  entries[e].prev = -1;
+  entries[e].next = head;
+  if (head != -1) entries[head].prev = e;
+  head = e;
+  if (tail == -1) tail = e;
+}
+
+static int cache_find(int fd, int sectorNum) {
+  for (int e = buckets[cache_bucket(fd, sectorNum)]; e != -1; e = entries[e].chain) {
+    if (entries[e].sectorNum == sectorNum && entries[e].fd == fd) return e;
+  }
+  return -1;
+}
+
+/**
+ * Claims an entry for the specified sector, evicting the least recently
+ * used one if the cache is full, and makes it the most recently used.
+ */
+static int cache_insert(int fd, int sectorNum) {
+  int e;
+  if (numUsed < capacity) {
+    e = numUsed++;
+  } else {
+    e = tail;
+    lru_unlink(e);
+    int *link = &buckets[cache_bucket(entries[e].fd, entries[e].sectorNum)];
+    while (*link != e) link = &entries[*link].chain;
+    *link = entries[e].chain;
+  }
+  entries[e].fd = fd;
+  entries[e].sectorNum = sectorNum;
+  int b = cache_bucket(fd, sectorNum);
+  entries[e].chain = buckets[b];
+  buckets[b] = e;
+  lru_pushfront(e);
+  return e;
+}
+
 int diskimg_open(char *pathname, int readOnly) {
   return open(pathname, readOnly ? O_RDONLY : O_RDWR);
 }
@@ -13,19 +126,155 @@ int diskimg_getsize(int fd) {
   return lseek(fd, 0, SEEK_END);
 }
 
+static void unmap_image(void) {
+  if (mappedImage != NULL) munmap(mappedImage, mappedSize);
+  mappedFd = -1;
+  mappedImage = NULL;
+  mappedSize = 0;
+}
+
 int diskimg_readsector(int fd, int sectorNum,  void *buf) {
-  if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) return -1;  
-  return read(fd, buf, DISKIMG_SECTOR_SIZE);
+  if (fd == mappedFd) {
+    if (sectorNum < 0 || (size_t) sectorNum * DISKIMG_SECTOR_SIZE >= mappedSize) return 0;
+    size_t numBytes = mappedSize - (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+    if (numBytes > DISKIMG_SECTOR_SIZE) numBytes = DISKIMG_SECTOR_SIZE;
+    memcpy(buf, mappedImage + (size_t) sectorNum * DISKIMG_SECTOR_SIZE, numBytes);
+    return numBytes;
+  }
+
+  pthread_mutex_lock(&cacheLock);
+  int cached = cache_init() == 0;
+  if (cached) {
+    int e = cache_find(fd, sectorNum);
+    if (e != -1) {
+      numHits++;
+      lru_unlink(e);
+      lru_pushfront(e);
+      memcpy(buf, entries[e].data, DISKIMG_SECTOR_SIZE);
+      pthread_mutex_unlock(&cacheLock);
+      return DISKIMG_SECTOR_SIZE;
+    }
+  }
+  numMisses++;
+  pthread_mutex_unlock(&cacheLock);
+
+  // pread rather than lseek and read, so concurrent readers can share fd
+  int numBytes = pread(fd, buf, DISKIMG_SECTOR_SIZE, (off_t) sectorNum * DISKIMG_SECTOR_SIZE);
+  // short reads (the tail of a truncated image) aren't worth remembering
+  if (cached && numBytes == DISKIMG_SECTOR_SIZE) {
+    pthread_mutex_lock(&cacheLock);
+    // another thread may have read the same sector in the meantime
+    if (entries != NULL && cache_find(fd, sectorNum) == -1) {
+      memcpy(entries[cache_insert(fd, sectorNum)].data, buf, DISKIMG_SECTOR_SIZE);
+    }
+    pthread_mutex_unlock(&cacheLock);
+  }
+  return numBytes;
+}
+
+int diskimg_readsectors(int fd, int sectorNum, int numSectors, void *buf) {
+  size_t start = (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+  size_t length = (size_t) numSectors * DISKIMG_SECTOR_SIZE;
+  if (fd == mappedFd) {
+    if (start >= mappedSize) return 0;
+    if (length > mappedSize - start) length = mappedSize - start;
+    memcpy(buf, mappedImage + start, length);
+    return length;
+  }
+
+  size_t numBytes = 0;
+  while (numBytes < length) {
+    ssize_t count = pread(fd, (char *) buf + numBytes, length - numBytes, start + numBytes);
+    if (count < 0) return -1;
+    if (count == 0) break;
+    numBytes += count;
+  }
+  return numBytes;
 }
 
 int diskimg_writesector(int fd, int sectorNum,  void *buf) {
+  if (fd == mappedFd) return -1; // mapped read-only
   if (lseek(fd, sectorNum * DISKIMG_SECTOR_SIZE, SEEK_SET) == (off_t) -1) {
     return -1;
   }
 
-  return write(fd, buf, DISKIMG_SECTOR_SIZE);
+  int numBytes = write(fd, buf, DISKIMG_SECTOR_SIZE);
+  pthread_mutex_lock(&cacheLock);
+  if (entries != NULL) {
+    int e = cache_find(fd, sectorNum);
+    if (e != -1 && numBytes == DISKIMG_SECTOR_SIZE) {
+      memcpy(entries[e].data, buf, DISKIMG_SECTOR_SIZE);
+    } else if (e != -1) {
+      // we no longer know what's on disk, so don't pretend to
+      cache_reset();
+    }
+  }
+  pthread_mutex_unlock(&cacheLock);
+  return numBytes;
 }
 
 int diskimg_close(int fd) {
+  // the descriptor number may well be reused for some other image, so
+  // nothing cached under it can be trusted once it's closed
+  if (entries != NULL) cache_reset();
+  if (fd == mappedFd) unmap_image();
   return close(fd);
 }
+
+int diskimg_setcachesize(int numSectors) {
+  free(entries);
+  free(buckets);
+  entries = NULL;
+  buckets = NULL;
+  numBuckets = 0;
+  capacity = numSectors < 0 ? 0 : numSectors;
+  if (capacity == 0) return 0;
+  return cache_init();
+}
+
+void diskimg_getcachestats(long *hits, long *misses) {
+  pthread_mutex_lock(&cacheLock);
+  *hits = numHits;
+  *misses = numMisses;
+  pthread_mutex_unlock(&cacheLock);
+}
+
+int diskimg_map(int fd) {
+  unmap_image();
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) return -1;
+  void *image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (image == MAP_FAILED) return -1;
+  mappedFd = fd;
+  mappedImage = image;
+  mappedSize = st.st_size;
+  return 0;
+}
+
+/**
+ * Returns the run of sectors in place, or NULL if fd isn't the mapped image
+ * or the image doesn't hold the whole run.
+ */
+static const void *runptr(int fd, int sectorNum, int numSectors) {
+  if (fd != mappedFd || sectorNum < 0) return NULL;
+  if ((size_t) (sectorNum + numSectors) * DISKIMG_SECTOR_SIZE > mappedSize) return NULL;
+  return mappedImage + (size_t) sectorNum * DISKIMG_SECTOR_SIZE;
+}
+
+const void *diskimg_sectorptr(int fd, int sectorNum) {
+  return runptr(fd, sectorNum, 1);
+}
+
+const void *diskimg_getsector(int fd, int sectorNum, void *buf) {
+  const void *sector = diskimg_sectorptr(fd, sectorNum);
+  if (sector != NULL) return sector;
+  if (diskimg_readsector(fd, sectorNum, buf) < 0) return NULL;
+  return buf;
+}
+
+const void *diskimg_getsectors(int fd, int sectorNum, int numSectors, void *buf) {
+  const void *run = runptr(fd, sectorNum, numSectors);
+  if (run != NULL) return run;
+  if (diskimg_readsectors(fd, sectorNum, numSectors, buf) < 0) return NULL;
+  return buf;
+}
@@ -6,6 +6,13 @@
 // Size of a disk sector (e.g. block) in bytes.
 #define DISKIMG_SECTOR_SIZE 512
 
+/**
+ * The read functions below (diskimg_readsector, diskimg_readsectors, and the
+ * in-place accessors) may be called from several threads at once, sharing one
+ * descriptor.  Everything else, mapping and resizing the cache included, is
+ * meant to be done before the threads start or after they finish.
+ */
+
 /**
  * Opens a disk image for I/O. Returns an open file descriptor, or -1 if
  * unsuccessful.  
@@ -23,6 +30,16 @@ int diskimg_getsize(int fd);
  */
 int diskimg_readsector(int fd, int sectorNum, void *buf); 
 
+/**
+ * Reads numSectors consecutive sectors, starting with sectorNum, into buf with a
+ * single system call (or a single copy, if the image is mapped).  This bypasses
+ * the sector cache (and its counters), since it's meant for streaming file
+ * contents through once.
+ * Returns the number of bytes read, which is short only at the end of the
+ * image, or -1 on error.
+ */
+int diskimg_readsectors(int fd, int sectorNum, int numSectors, void *buf);
+
 /**
  * Writes the specified sector from the disk.  Returns the number of bytes
  * written, or -1 on error.
@@ -35,4 +52,53 @@ int diskimg_writesector(int fd, int sectorNum, void *buf);
  */
 int diskimg_close(int fd);
 
+// Number of sectors the sector cache holds unless told otherwise (256 KB worth).
+#define DISKIMG_DEFAULT_CACHE_SECTORS 512
+
+/**
+ * diskimg_readsector is backed by an LRU cache of recently read sectors, so
+ * the inode, indirect, and directory blocks that get re-read over and over
+ * cost a memcpy rather than an lseek and a read.  Writes go through to the
+ * disk and update any cached copy.  Sets the number of sectors the cache can
+ * hold, discarding everything currently cached; 0 turns the cache off.
+ * Returns 0 on success, or -1 if the space couldn't be allocated (in which
+ * case the cache is left off).
+ */
+int diskimg_setcachesize(int numSectors);
+
+/**
+ * Maps the entire image open on fd into memory, read-only, after which sectors
+ * from it can be read in place with diskimg_sectorptr, and diskimg_readsector
+ * copies out of the mapping instead of going to the disk (or the sector cache).
+ * Only one image can be mapped at a time; mapping another unmaps the first, as
+ * does closing it.  Returns 0 on success, or -1 on error.
+ */
+int diskimg_map(int fd);
+
+/**
+ * Returns a pointer to the specified sector within the mapping made by
+ * diskimg_map, or NULL if fd isn't mapped or the image doesn't hold the
+ * whole sector.  The memory is valid until the image is closed.
+ */
+const void *diskimg_sectorptr(int fd, int sectorNum);
+
+/**
+ * Convenience wrapper for callers that only need to look at a sector: returns
+ * it in place if the image is mapped, and otherwise reads it into buf (which must
+ * be DISKIMG_SECTOR_SIZE bytes) and returns buf.  Returns NULL if the read fails.
+ */
+const void *diskimg_getsector(int fd, int sectorNum, void *buf);
+
+/**
+ * Same as diskimg_getsector, but for a run of numSectors consecutive sectors,
+ * which are read with diskimg_readsectors when they can't be had in place.
+ */
+const void *diskimg_getsectors(int fd, int sectorNum, int numSectors, void *buf);
+
+/**
+ * Reports how many sector reads have been satisfied from the cache (hits)
+ * and how many had to go to the disk (misses) so far.
+ */
+void diskimg_getcachestats(long *hits, long *misses);
+
 #endif // _DISKIMG_H_
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #include "file.h"
 #include "inode.h"
@@ -40,12 +41,133 @@ int file_getblock(struct unixfilesystem *fs, int inumber, int blockNum, void *bu
     printf("Inode lookup error!\n");
     return ERROR;
   }
-  int numbytesread = diskimg_readsector(fs->dfd, blockNo, buf);
-  if (numbytesread == ERROR)
+  // with the image mapped this is the only copy the block goes through;
+  // otherwise the read lands in buf directly
+  const void *block = diskimg_getsector(fs->dfd, blockNo, buf);
+  if (block == NULL)
   {
     printf("Read error!\n");
     return ERROR;
   }
+  if (block != buf) memcpy(buf, block, DISKIMG_SECTOR_SIZE);
   return getvalidbytes(fs, inumber, blockNum, buf, &inp);
 }
 
+
+int file_iterinit(struct file_iterator *it, struct unixfilesystem *fs, int inumber, int blockNo) {
+  if (inode_iget(fs, inumber, &it->in) == ERROR) return ERROR;
+  it->fs = fs;
+  it->size = inode_getsize(&it->in);
+  it->numBlocks = (it->size + DISKIMG_SECTOR_SIZE - 1) / DISKIMG_SECTOR_SIZE;
+  it->blockNum = blockNo;
+  it->indirectNum = -1;
+  it->indirect = NULL;
+  it->doubly = NULL;
+  return 0;
+}
+
+/**
+ * Same mapping from file block to disk block as inode_indexlookup, except
+ * that indirect blocks only get read when the walk moves on to a new one.
+ */
+static int iterator_lookup(struct file_iterator *it, int blockNum)
+{
+  if ((it->in.i_mode & ILARG) == 0) return it->in.i_addr[blockNum];
+  int indirectNum = blockNum / BLOCKNUMBERSPERBLOCK;
+  if (indirectNum != it->indirectNum)
+  {
+    int indirectSector;
+    if (indirectNum < MAXNUMPAYLOADBLOCKSLEVEL1)
+    {
+      indirectSector = it->in.i_addr[indirectNum];
+    }
+    else
+    {
+      if (it->doubly == NULL)
+      {
+        it->doubly = diskimg_getsector(it->fs->dfd, it->in.i_addr[LASTIADDR], it->doublyBuf);
+        if (it->doubly == NULL) return ERROR;
+      }
+      indirectSector = it->doubly[indirectNum - MAXNUMPAYLOADBLOCKSLEVEL1];
+    }
+    it->indirect = diskimg_getsector(it->fs->dfd, indirectSector, it->indirectBuf);
+    if (it->indirect == NULL)
+    {
+      it->indirectNum = -1;
+      return ERROR;
+    }
+    it->indirectNum = indirectNum;
+  }
+  return it->indirect[blockNum % BLOCKNUMBERSPERBLOCK];
+}
+
+int file_nextrun(struct file_iterator *it, int maxBlocks, int *sectorNum, int *numBytes) {
+  if (it->blockNum >= it->numBlocks) return 0;
+  int first = iterator_lookup(it, it->blockNum);
+  if (first == ERROR) return ERROR;
+  int count = 1;
+  while (count < maxBlocks && it->blockNum + count < it->numBlocks)
+  {
+    int next = iterator_lookup(it, it->blockNum + count);
+    if (next == ERROR) return ERROR;
+    if (next != first + count) break;
+    count++;
+  }
+  int start = it->blockNum * DISKIMG_SECTOR_SIZE;
+  int end = (it->blockNum + count) * DISKIMG_SECTOR_SIZE;
+  if (end > it->size) end = it->size;
+  *sectorNum = first;
+  *numBytes = end - start;
+  it->blockNum += count;
+  return count;
+}
+
+int file_readnext(struct file_iterator *it, void *buf, int maxBlocks, const void **data) {
+  int sectorNum, numBytes;
+  int numBlocks = file_nextrun(it, maxBlocks, &sectorNum, &numBytes);
+  if (numBlocks <= 0) return numBlocks;
+  *data = diskimg_getsectors(it->fs->dfd, sectorNum, numBlocks, buf);
+  if (*data == NULL)
+  {
+    printf("Read error!\n");
+    return ERROR;
+  }
+  return numBytes;
+}
+
+int file_readrange(struct unixfilesystem *fs, int inumber, int offset, int len, void *buf) {
+  struct file_iterator it;
+  if (offset < 0 || len < 0 || file_iterinit(&it, fs, inumber, offset / DISKIMG_SECTOR_SIZE) == ERROR) return ERROR;
+  if (offset >= it.size) return 0;
+  if (len > it.size - offset) len = it.size - offset;
+
+  char *dest = buf;
+  int copied = 0;
+  while (copied < len)
+  {
+    int skip = (offset + copied) % DISKIMG_SECTOR_SIZE;
+    int wholeBlocks = (len - copied) / DISKIMG_SECTOR_SIZE;
+    if (skip == 0 && wholeBlocks > 0)
+    {
+      // whole blocks go straight into the caller's buffer
+      const void *data;
+      int numBytes = file_readnext(&it, dest + copied, wholeBlocks, &data);
+      if (numBytes <= 0) return ERROR;
+      if (data != dest + copied) memcpy(dest + copied, data, numBytes);
+      copied += numBytes;
+    }
+    else
+    {
+      // a partial block at either end goes through a bounce buffer
+      char block[DISKIMG_SECTOR_SIZE];
+      const void *data;
+      int numBytes = file_readnext(&it, block, 1, &data);
+      if (numBytes <= skip) return ERROR;
+      int count = numBytes - skip;
+      if (count > len - copied) count = len - copied;
+      memcpy(dest + copied, (const char *) data + skip, count);
+      copied += count;
+    }
+  }
+  return copied;
+}
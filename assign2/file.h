@@ -2,6 +2,8 @@
 #define _FILE_H_
 
 #include "unixfilesystem.h"
+#include "diskimg.h"
+#include "inode.h"
 
 /**
  * Fetches the specified file block from the specified inode.
@@ -9,4 +11,55 @@
  */
 int file_getblock(struct unixfilesystem *fs, int inumber, int blockNo, void *buf); 
 
+/**
+ * A cursor over the blocks of one file, for reading it front to back.  The
+ * inode is fetched once, when the iterator is set up, and the indirect block
+ * currently in use (and the doubly indirect block, once needed) is kept around,
+ * so each indirect block is read once per 256 file blocks rather than once per
+ * file block.  Nothing needs to be cleaned up afterwards.
+ */
+struct file_iterator {
+  struct unixfilesystem *fs;
+  struct inode in;
+  int size;                  // in bytes
+  int numBlocks;
+  int blockNum;              // the next file block to hand out
+  int indirectNum;           // which of the file's indirect blocks indirect holds, -1 if none
+  const uint16_t *indirect;  // in place in a mapped image, or else in indirectBuf
+  const uint16_t *doubly;    // the doubly indirect block, NULL until needed
+  uint16_t indirectBuf[BLOCKNUMBERSPERBLOCK];
+  uint16_t doublyBuf[BLOCKNUMBERSPERBLOCK];
+};
+
+/**
+ * Sets up an iterator over the specified file, starting from file block
+ * blockNo.  Returns 0 on success, -1 on error.
+ */
+int file_iterinit(struct file_iterator *it, struct unixfilesystem *fs, int inumber, int blockNo);
+
+/**
+ * Advances the iterator over the next run of file blocks that are also
+ * consecutive on disk, taking at most maxBlocks of them.  Sets *sectorNum to
+ * the run's first sector and *numBytes to the number of valid bytes in it.
+ * Returns the number of blocks in the run, 0 once the whole file has been
+ * covered, or -1 on error.
+ */
+int file_nextrun(struct file_iterator *it, int maxBlocks, int *sectorNum, int *numBytes);
+
+/**
+ * Reads the next run (as chosen by file_nextrun) with a single disk read.
+ * buf must have room for maxBlocks sectors; *data is pointed at the run's
+ * contents, which are in place if the image is mapped and in buf otherwise.
+ * Returns the number of valid bytes, 0 once the whole file has been read,
+ * or -1 on error.
+ */
+int file_readnext(struct file_iterator *it, void *buf, int maxBlocks, const void **data);
+
+/**
+ * Copies up to len bytes of the specified file, starting at byte offset, into
+ * buf.  Returns the number of bytes copied, which is less than len only if the
+ * file ends first, or -1 on error.
+ */
+int file_readrange(struct unixfilesystem *fs, int inumber, int offset, int len, void *buf);
+
 #endif // _FILE_H_
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 #include "inode.h"
 #include "diskimg.h"
@@ -41,19 +42,19 @@ int inode_iget(struct unixfilesystem *fs, int inumber, struct inode *inp) {
   // root_inumber from inumber so division by inodenumperblock would
   // automatically round down to the correct block offset
   int blockNumber = inumberind_2_blockind(inumber);
-  // create an array of inodes 
+  // space for an array of inodes, in case the block can't be read in place
   struct inode inode_arr[INODESPERBLOCK]; 
-  // get the inode out of the block
-  int bytesread = diskimg_readsector(fs->dfd, blockNumber, inode_arr);
+  // get the block of inodes
+  const struct inode *inodes = diskimg_getsector(fs->dfd, blockNumber, inode_arr);
   // check if reading from disk was successful  
-  if (bytesread == ERROR)
+  if (inodes == NULL)
   {
     printf("ReadError!\n");
     return ERROR;
   }
   // copy the relevant inode using the zero-indexed inumber 
   int blockIndexOffset = inodeindex_in_block(inumber);
-  *inp = inode_arr[blockIndexOffset];
+  *inp = inodes[blockIndexOffset];
   return 0;
 }
 
@@ -63,9 +64,9 @@ int getBlockNumInInode(int blockNum, struct inode *inp)
   return inp->i_addr[index];
 }
 
-int getBlockNumInIndBlock(int blockNum, void *buf)
+int getBlockNumInIndBlock(int blockNum, const void *buf)
 {
-  return *((uint16_t *)buf + (blockNum % BLOCKNUMBERSPERBLOCK));
+  return *((const uint16_t *)buf + (blockNum % BLOCKNUMBERSPERBLOCK));
 }
 
 int large_file_index(int blockNum, struct unixfilesystem *fs, struct inode *inp)
@@ -74,8 +75,8 @@ int large_file_index(int blockNum, struct unixfilesystem *fs, struct inode *inp)
   char buf[DISKIMG_SECTOR_SIZE];
   // read block whose block number is stored in the 8th slot, doubly
   // indirect block
-  int numbytesread = diskimg_readsector(fs->dfd, inp->i_addr[LASTIADDR], buf);
-  if (numbytesread == ERROR)
+  const void *block = diskimg_getsector(fs->dfd, inp->i_addr[LASTIADDR], buf);
+  if (block == NULL)
   {
     return ERROR;
   }
@@ -86,7 +87,7 @@ int large_file_index(int blockNum, struct unixfilesystem *fs, struct inode *inp)
   int blockindneeded = remainingpayload / BLOCKNUMBERSPERBLOCK;
   // cast the char buffer as 2-byte ints and add the offset,
   // dereference this pointer to get the number itself
-  int indirectblockNum = *((uint16_t *)buf + blockindneeded);
+  int indirectblockNum = *((const uint16_t *)block + blockindneeded);
   return indirectblockNum;
 }
 
@@ -119,15 +120,72 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
   }
     // read this indirect block out of memory
   char buf[DISKIMG_SECTOR_SIZE];
-  int numbytesread = diskimg_readsector(fs->dfd, indblockNum, buf);
-  if (numbytesread == ERROR)
+  const void *block = diskimg_getsector(fs->dfd, indblockNum, buf);
+  if (block == NULL)
   {
     printf("Read Error\n");
     return ERROR;
   }    
-  return getBlockNumInIndBlock(blockNum, buf);
+  return getBlockNumInIndBlock(blockNum, block);
 }
 
-int inode_getsize(struct inode *inp) {
+int inode_getsize(const struct inode *inp) {
   return ((inp->i_size0 << 16) | inp->i_size1); 
 }
+
+/**
+ * Returns the inodes held by the numSectors sectors of the inode table starting
+ * with sectorNum, in place if the image is mapped and in buf otherwise.  Inodes
+ * past the end of a short image come back zeroed, which is to say unallocated.
+ */
+static const struct inode *get_inode_sectors(struct unixfilesystem *fs, int sectorNum, int numSectors,
+                                             struct inode *buf)
+{
+  // the mapping is contiguous, so the run is in place if its first and last sectors are
+  const void *run = diskimg_sectorptr(fs->dfd, sectorNum);
+  if (run != NULL && diskimg_sectorptr(fs->dfd, sectorNum + numSectors - 1) != NULL) return run;
+  int numBytes = diskimg_readsectors(fs->dfd, sectorNum, numSectors, buf);
+  if (numBytes < 0) return NULL;
+  memset((char *) buf + numBytes, 0, numSectors * DISKIMG_SECTOR_SIZE - numBytes);
+  return buf;
+}
+
+int inode_iget_range(struct unixfilesystem *fs, int firstInumber, int numInodes, struct inode *inodes) {
+  if (firstInumber < ROOT_INUMBER || numInodes < 0) return ERROR;
+  struct inode buf[INODE_SCAN_SECTORS * INODESPERBLOCK];
+  int done = 0;
+  while (done < numInodes)
+  {
+    int inumber = firstInumber + done;
+    int sectorNum = inumberind_2_blockind(inumber);
+    int skip = inodeindex_in_block(inumber);
+    int count = numInodes - done;
+    if (count > INODE_SCAN_SECTORS * (int) INODESPERBLOCK - skip) count = INODE_SCAN_SECTORS * INODESPERBLOCK - skip;
+    int numSectors = (skip + count + INODESPERBLOCK - 1) / INODESPERBLOCK;
+    const struct inode *block = get_inode_sectors(fs, sectorNum, numSectors, buf);
+    if (block == NULL) return ERROR;
+    memcpy(inodes + done, block + skip, count * sizeof(struct inode));
+    done += count;
+  }
+  return 0;
+}
+
+int inode_scan(struct unixfilesystem *fs, inode_scanfn fn, void *aux) {
+  struct inode buf[INODE_SCAN_SECTORS * INODESPERBLOCK];
+  int endSector = INODE_START_SECTOR + fs->superblock.s_isize;
+  for (int sectorNum = INODE_START_SECTOR; sectorNum < endSector; sectorNum += INODE_SCAN_SECTORS)
+  {
+    int numSectors = endSector - sectorNum;
+    if (numSectors > INODE_SCAN_SECTORS) numSectors = INODE_SCAN_SECTORS;
+    const struct inode *block = get_inode_sectors(fs, sectorNum, numSectors, buf);
+    if (block == NULL) return ERROR;
+    int firstInumber = (sectorNum - INODE_START_SECTOR) * INODESPERBLOCK + ROOT_INUMBER;
+    for (int i = 0; i < numSectors * (int) INODESPERBLOCK; i++)
+    {
+      if ((block[i].i_mode & IALLOC) == 0) continue;
+      int stop = fn(fs, firstInumber + i, &block[i], aux);
+      if (stop != 0) return stop;
+    }
+  }
+  return 0;
+}
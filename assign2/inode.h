@@ -29,6 +29,32 @@ int inode_indexlookup(struct unixfilesystem *fs, struct inode *inp, int blockNum
 /**
  * Computes the size in bytes of the file identified by the given inode
  */
-int inode_getsize(struct inode *inp);
+int inode_getsize(const struct inode *inp);
+
+// Number of inode sectors inode_scan and inode_iget_range read at a time.
+#define INODE_SCAN_SECTORS 32
+
+/**
+ * Fetches numInodes consecutive inodes, starting with firstInumber, into the
+ * inodes array, reading the inode table INODE_SCAN_SECTORS sectors at a time
+ * rather than one sector per inode.  Returns 0 on success, -1 on error.
+ */
+int inode_iget_range(struct unixfilesystem *fs, int firstInumber, int numInodes, struct inode *inodes);
+
+/**
+ * Called by inode_scan for each allocated inode.  inp points straight into
+ * the scan's buffer (or into the mapped image) and is only good until the
+ * callback returns.  Returning anything other than 0 stops the scan.
+ */
+typedef int (*inode_scanfn)(struct unixfilesystem *fs, int inumber, const struct inode *inp, void *aux);
+
+/**
+ * Hands every allocated inode in the inode table (INODE_START_SECTOR through
+ * s_isize) to fn, in inumber order, along with aux.  The table is read
+ * INODE_SCAN_SECTORS sectors at a time, and unallocated inodes are passed
+ * over without a call.  Returns 0 once every inode has been visited, the
+ * value fn returned if it stopped the scan early, or -1 on a read error.
+ */
+int inode_scan(struct unixfilesystem *fs, inode_scanfn fn, void *aux);
 
 #endif // _INODE_
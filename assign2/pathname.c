@@ -21,7 +21,9 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
     struct direntv6 directoryEntry;
     int err;
 
-    pch = strtok(path, "/");
+    // strtok_r rather than strtok, since lookups may run on several threads at once
+    char *saveptr;
+    pch = strtok_r(path, "/", &saveptr);
     int directory_inumber = ROOT_INUMBER;
     
     while (pch != NULL)
@@ -30,10 +32,11 @@ int pathname_lookup(struct unixfilesystem *fs, const char *pathname) {
       if (err < 0)
       {
         printf("Unable to find directory entry\n");
+        free(path);
         return ERROR;
       }
       directory_inumber = directoryEntry.d_inumber;
-      pch = strtok(NULL, "/");
+      pch = strtok_r(NULL, "/", &saveptr);
     }
     free(path);
     return directory_inumber;
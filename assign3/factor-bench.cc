@@ -0,0 +1,93 @@
+/**
+ * File: factor-bench.cc
+ * ---------------------
+ * Benchmarks the native factor worker against factor.py over farm's input files
+ * (farm_input1 through farm_input8, unless others are named on the command line).
+ * Each worker is run just as farm --streaming runs it, one process per input file
+ * fed one number at a time, and is timed from spawn to exit, so interpreter startup
+ * counts against factor.py just as it does in farm.  The two workers' factorizations
+ * are compared as well, and any disagreement is reported.
+ */
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <ext/stdio_filebuf.h>
+#include "subprocess.h"
+using namespace std;
+using namespace __gnu_cxx; // __gnu_cxx::stdio_filebuf -> stdio_filebuf
+
+static const int kInputFileNotFound = 1;
+static const char *kDefaultInputs[] = {
+  "farm_input1", "farm_input2", "farm_input3", "farm_input4",
+  "farm_input5", "farm_input6", "farm_input7", "farm_input8"
+};
+
+/**
+ * Function: runWorker
+ * -------------------
+ * Feeds every number to a fresh instance of the named worker, collecting its answers
+ * (minus the pid and timing that follow them), and returns the elapsed seconds.
+ */
+static double runWorker(const char *workerPath, const vector<string>& numbers, vector<string>& answers) {
+  auto start = chrono::steady_clock::now();
+  const char *argv[] = {workerPath, NULL};
+  subprocess_t sp = subprocess(const_cast<char **>(argv), true, true);
+  stdio_filebuf<char> inbuf(sp.ingestfd, ios::in);
+  istream is(&inbuf);
+  answers.clear();
+  for (const string& number : numbers) {
+    dprintf(sp.supplyfd, "%s\n", number.c_str());
+    string answer;
+    if (!getline(is, answer)) break;
+    answers.push_back(answer.substr(0, answer.find(" [pid:")));
+  }
+  close(sp.supplyfd);
+  waitpid(sp.pid, NULL, 0);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return elapsed.count();
+} // stdio_filebuf destroyed, destructor closes ingestfd
+
+int main(int argc, char *argv[]) {
+  vector<string> inputs;
+  if (argc > 1) inputs.assign(argv + 1, argv + argc);
+  else inputs.assign(begin(kDefaultInputs), end(kDefaultInputs));
+
+  size_t totalNumbers = 0;
+  double pythonTotal = 0, nativeTotal = 0;
+  cout << setw(14) << "input" << setw(9) << "numbers" << setw(16) << "factor.py" << setw(16) << "factor" << endl;
+  for (const string& input : inputs) {
+    ifstream infile(input);
+    if (infile.fail()) {
+      cerr << "Couldn't open \"" << input << "\".  Aborting..." << endl;
+      return kInputFileNotFound;
+    }
+    vector<string> numbers;
+    string line;
+    while (getline(infile, line)) {
+      if (!line.empty()) numbers.push_back(line);
+    }
+
+    vector<string> pythonAnswers, nativeAnswers;
+    double pythonTime = runWorker("./factor.py", numbers, pythonAnswers);
+    double nativeTime = runWorker("./factor", numbers, nativeAnswers);
+    totalNumbers += numbers.size();
+    pythonTotal += pythonTime;
+    nativeTotal += nativeTime;
+    cout << setw(14) << input << setw(9) << numbers.size() << fixed << setprecision(1)
+         << setw(11) << numbers.size() / pythonTime << " n/s" << setw(11) << numbers.size() / nativeTime << " n/s";
+    if (pythonAnswers != nativeAnswers) cout << "  (answers differ!)";
+    cout << endl;
+  }
+
+  cout << setw(14) << "total" << setw(9) << totalNumbers << fixed << setprecision(1)
+       << setw(11) << totalNumbers / pythonTotal << " n/s" << setw(11) << totalNumbers / nativeTotal << " n/s";
+  if (nativeTotal > 0) cout << " (" << pythonTotal / nativeTotal << "x speedup)";
+  cout << endl;
+  return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * File: factor.cc
+ * ---------------
+ * A native stand-in for factor.py that speaks exactly the same protocol, so farm can
+ * drive either one: it reads one number per line from stdin and prints
+ *
+ *     <number> = <factor> * <factor> * ... [pid: <pid>, time: <seconds> seconds]
+ *
+ * for each, with the factors in ascending order.  Given --self-halting, it stops itself
+ * with SIGSTOP before reading each number, just as factor.py does.  Given --pool, it
+ * instead serves as a SubprocessPool worker, answering each request frame holding a
+ * number with a response frame holding that same line (minus the newline).
+ *
+ * Rather than trial dividing by everything below the number, it strips off the primes
+ * in a small sieve, and then splits whatever's left with Pollard's rho (Brent's
+ * variant), using a deterministic Miller-Rabin test to recognize the primes, which
+ * handles any 64-bit input in well under a millisecond.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <csignal>
+#include <cstring>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "subprocess-pool.h"
+
+using namespace std;
+
+__extension__ typedef unsigned __int128 uint128;
+
+static const uint64_t kSieveLimit = 1 << 16;
+
+static vector<uint64_t> sievePrimes(uint64_t limit) {
+  vector<bool> composite(limit, false);
+  vector<uint64_t> primes;
+  for (uint64_t i = 2; i < limit; i++) {
+    if (composite[i]) continue;
+    primes.push_back(i);
+    for (uint64_t j = i * i; j < limit; j += i) composite[j] = true;
+  }
+  return primes;
+}
+
+static const vector<uint64_t> kSmallPrimes = sievePrimes(kSieveLimit);
+
+static uint64_t mulmod(uint64_t a, uint64_t b, uint64_t m) {
+  return (uint128) a * b % m;
+}
+
+static uint64_t powmod(uint64_t base, uint64_t exponent, uint64_t m) {
+  uint64_t result = 1;
+  base %= m;
+  while (exponent > 0) {
+    if (exponent & 1) result = mulmod(result, base, m);
+    base = mulmod(base, base, m);
+    exponent >>= 1;
+  }
+  return result;
+}
+
+/**
+ * Deterministic Miller-Rabin: these seven bases are known to admit no
+ * strong pseudoprimes below 2^64.
+ */
+static bool isPrime(uint64_t n) {
+  if (n < 2) return false;
+  for (uint64_t p : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+    if (n % p == 0) return n == p;
+  }
+  uint64_t d = n - 1;
+  int shift = 0;
+  while ((d & 1) == 0) {
+    d >>= 1;
+    shift++;
+  }
+  for (uint64_t base : {2ULL, 325ULL, 9375ULL, 28178ULL, 450775ULL, 9780504ULL, 1795265022ULL}) {
+    uint64_t x = powmod(base, d, n);
+    if (x == 0 || x == 1 || x == n - 1) continue;
+    bool witness = true;
+    for (int r = 1; r < shift && witness; r++) {
+      x = mulmod(x, x, n);
+      if (x == n - 1) witness = false;
+    }
+    if (witness) return false;
+  }
+  return true;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+/**
+ * Returns a nontrivial factor of n, which must be odd and composite, using Brent's
+ * variant of Pollard's rho, with the gcds batched over runs of 128 steps.
+ */
+static uint64_t findFactor(uint64_t n) {
+  for (uint64_t c = 1;; c++) {
+    uint64_t y = 2, x = 2, saved = 2, product = 1, g = 1;
+    for (uint64_t length = 1; g == 1; length *= 2) {
+      x = y;
+      for (uint64_t i = 0; i < length; i++) y = (mulmod(y, y, n) + c) % n;
+      for (uint64_t k = 0; k < length && g == 1; k += 128) {
+        saved = y;
+        for (uint64_t i = 0; i < min<uint64_t>(128, length - k); i++) {
+          y = (mulmod(y, y, n) + c) % n;
+          product = mulmod(product, x > y ? x - y : y - x, n);
+        }
+        g = gcd(product, n);
+      }
+    }
+    if (g == n) {
+      // the batch overshot, so step back through it one gcd at a time
+      do {
+        saved = (mulmod(saved, saved, n) + c) % n;
+        g = gcd(x > saved ? x - saved : saved - x, n);
+      } while (g == 1);
+    }
+    if (g != n) return g;
+  }
+}
+
+static void splitFactor(uint64_t n, vector<uint64_t>& factors) {
+  if (n == 1) return;
+  if (isPrime(n)) {
+    factors.push_back(n);
+    return;
+  }
+  uint64_t d = findFactor(n);
+  splitFactor(d, factors);
+  splitFactor(n / d, factors);
+}
+
+/**
+ * Produces the same text factor.py's factorization does, quirks and all: numbers
+ * below 2 have no factors listed unless they're 1, which (like a prime) is listed
+ * as its own factor.
+ */
+static string factorization(long long num) {
+  string response = to_string(num) + " =";
+  if (num == 1) return response + " 1";
+  if (num < 2) return response + " ";
+  vector<uint64_t> factors;
+  uint64_t n = num;
+  for (uint64_t p : kSmallPrimes) {
+    if (p * p > n) break;
+    while (n % p == 0) {
+      factors.push_back(p);
+      n /= p;
+    }
+  }
+  splitFactor(n, factors);
+  sort(factors.begin(), factors.end());
+  for (size_t i = 0; i < factors.size(); i++) {
+    response += (i == 0 ? " " : " * ") + to_string(factors[i]);
+  }
+  return response;
+}
+
+/**
+ * Function: answer
+ * ----------------
+ * Factors the number in line and returns the full answer, timing included, or
+ * returns false if the line doesn't hold a number.
+ */
+static bool answer(const string& line, string& response) {
+  long long num;
+  try {
+    num = stoll(line);
+  } catch (const exception& e) {
+    return false;
+  }
+  auto start = chrono::steady_clock::now();
+  string factors = factorization(num);
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), " [pid: %d, time: %g seconds]", getpid(), elapsed.count());
+  response = factors + suffix;
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  // as with factor.py, don't outlive farm, stopped or otherwise
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+  bool selfHalting = argc > 1 && strcmp(argv[1], "--self-halting") == 0;
+  bool pooled = argc > 1 && strcmp(argv[1], "--pool") == 0;
+  while (true) {
+    if (selfHalting) raise(SIGSTOP);
+    string line, response;
+    if (pooled ? !readFrame(STDIN_FILENO, line) : !getline(cin, line)) break;
+    if (!answer(line, response)) break;
+    if (pooled) {
+      if (!writeFrame(STDOUT_FILENO, response)) break;
+    } else {
+      // one write per answer, and flushed, for the same reasons factor.py gives
+      printf("%s\n", response.c_str());
+      fflush(stdout);
+    }
+  }
+  return 0;
+}
@@ -35,5 +35,8 @@ while True:
     start = time.time()
     response = factorization(num)
     stop = time.time()
-    print '%s [pid: %d, time: %g seconds]' % (response, pid, stop - start)
+    # one write per answer, so answers from workers sharing a pipe never interleave,
+    # and flushed, since in streaming mode each line is farm's acknowledgement
+    sys.stdout.write('%s [pid: %d, time: %g seconds]\n' % (response, pid, stop - start))
+    sys.stdout.flush()
     
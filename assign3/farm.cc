@@ -1,10 +1,18 @@
+#include <algorithm>
 #include <cassert>
+#include <csignal>
 #include <ctime>
 #include <cctype>
 #include <cstdio>
 #include <iostream>
 #include <cstdlib>
 #include <vector>
+#include <deque>
+#include <string>
+#include <cstring>
+#include <unordered_map>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <sched.h>
@@ -16,120 +24,384 @@
 using namespace std;
 
 static const int kWaitFailed = 3;
+static const int kEventLoopFailed = 4;
+static const int kNumbersUnanswered = 5;
 
 struct worker {
   worker() {}
-  worker(char *argv[]) : sp(subprocess(argv, true, false)), available(false) {}
-  subprocess_t sp;
-  bool available;
+  worker(char *argv[], bool ingest = false) : sp(subprocess(argv, true, ingest)) {}
+  subprocess_t sp;      // supplyfd is kNotInUse once it's been closed
+  deque<long long> pending; // numbers sent but not yet answered, oldest first
+  string partial;     // streaming mode only: the start of an answer whose newline hasn't arrived yet
 };
 
 static const size_t kNumCPUs = sysconf(_SC_NPROCESSORS_ONLN);
-static vector<worker> workers(kNumCPUs);
-static size_t numWorkersAvailable = 0;
+static vector<worker> workers;
+static unordered_map<pid_t, size_t> workerIndices;
+static size_t numLiveWorkers;
+static size_t numUnanswered; // numbers handed to workers that exited before answering them
 
-static void markWorkersAsAvailable(int sig) {
-  pid_t pid;
-  while(true)
-  {
-    pid = waitpid(-1, NULL, WNOHANG | WUNTRACED);
-    if (pid <= 0) break;
-    for (size_t i = 0; i < kNumCPUs; i++)
-    {
-      if (workers[i].sp.pid == pid)
-      {
-        workers[i].available = true;
-        numWorkersAvailable++;
-        break;
-      }
-    }
-  }
-  exitUnless(pid == 0 || errno == ECHILD, kWaitFailed, stderr, "waitpid failed within markWorkerAsAvailable sighandler.\n");
-}
+/**
+ * The free list.  Every entry is one credit: permission to hand one more number to
+ * the worker at that index.  Signal-driven workers get a credit each time they stop
+ * and streaming workers get one back with each answer, so dispatch just pops the
+ * front, and nothing ever scans the workers to find one with room.
+ */
+static deque<size_t> credits;
+
+/**
+ * Streaming mode
+ * --------------
+ * Rather than stopping after every number and waiting to be continued, each worker
+ * just keeps reading numbers from its supplyfd and writing one line of output per
+ * number to its ingestfd, which farm reads and passes along to its own stdout.  Each
+ * line of output doubles as an acknowledgement, so farm knows how many numbers each
+ * worker has yet to answer, and never lets that count exceed the credit window.
+ * That keeps every worker busy without any signals going back and forth, and without
+ * piling up more work on one worker than it can get through.
+ */
+static const size_t kDefaultCreditWindow = 4;
 
-static const char *kWorkerArguments[] = {"./factor.py", "--self-halting", NULL};
-static void spawnAllWorkers() {
+// any program that speaks factor.py's protocol will do, native factor included
+static const char *kDefaultWorker = "./factor.py";
+static void spawnAllWorkers(const char *workerPath, size_t numWorkers, bool streaming) {
   cout << "There are this many CPUs: " << kNumCPUs << ", numbered 0 through " << kNumCPUs - 1 << "." << endl;
-  for (size_t i = 0; i < kNumCPUs; i++) {
-    workers[i] = worker(const_cast<char **>(kWorkerArguments));
+  const char *workerArguments[] = {workerPath, streaming ? NULL : "--self-halting", NULL};
+  workers.resize(numWorkers);
+  for (size_t i = 0; i < numWorkers; i++) {
+    workers[i] = worker(const_cast<char **>(workerArguments), streaming);
+    workerIndices[workers[i].sp.pid] = i;
     cpu_set_t cpusetp;
     CPU_ZERO(&cpusetp);
-    CPU_SET(i, &cpusetp);
-    sched_setaffinity(workers[i].sp.pid, sizeof(cpu_set_t), &cpusetp); 
-    cout << "Worker " << workers[i].sp.pid << " is set to run on CPU " << i << "." << endl;
+    CPU_SET(i % kNumCPUs, &cpusetp);
+    sched_setaffinity(workers[i].sp.pid, sizeof(cpu_set_t), &cpusetp);
+    cout << "Worker " << workers[i].sp.pid << " is set to run on CPU " << i % kNumCPUs << "." << endl;
   }
+  numLiveWorkers = numWorkers;
 }
 
-static size_t getAvailableWorker() {
-  sigset_t additions, existingmask;
-  sigemptyset(&additions);
-  sigaddset(&additions, SIGCHLD);
-  sigprocmask(SIG_BLOCK, &additions, &existingmask);
-  while(numWorkersAvailable == 0)
-  {
-    sigsuspend(&existingmask);
+/**
+ * Gives up on worker i, which has exited (or at least closed its end of the ingest
+ * pipe): reports whatever it was handed but never answered, and takes back all of
+ * its credits so it's never handed anything else.
+ */
+static void retireWorker(size_t i) {
+  worker& w = workers[i];
+  if (!w.pending.empty()) {
+    cerr << "Worker " << w.sp.pid << " exited before finishing with:";
+    for (long long num : w.pending) cerr << " " << num;
+    cerr << endl;
+    numUnanswered += w.pending.size();
+    w.pending.clear();
   }
-  size_t worker_available;
-  for (size_t i = 0; i < kNumCPUs; i++)
-  {
-    if (workers[i].available)
-    {
-       worker_available = i;
-       workers[i].available = false;
-       numWorkersAvailable--;
-       break;
+  credits.erase(remove(credits.begin(), credits.end(), i), credits.end());
+  if (w.sp.supplyfd != kNotInUse) close(w.sp.supplyfd);
+  w.sp.supplyfd = kNotInUse;
+  numLiveWorkers--;
+}
+
+/**
+ * Hands num to worker i.  SIGPIPE is blocked while writing, since the worker may have
+ * exited without farm having noticed yet; the number is recorded as pending either
+ * way, and is reported once the worker's exit is seen.
+ */
+static void sendNumber(size_t i, long long num) {
+  sigset_t pipeMask, existingMask;
+  sigemptyset(&pipeMask);
+  sigaddset(&pipeMask, SIGPIPE);
+  sigprocmask(SIG_BLOCK, &pipeMask, &existingMask);
+  if (dprintf(workers[i].sp.supplyfd, "%lld\n", num) < 0 && errno == EPIPE) {
+    struct timespec zero = {0, 0};
+    sigtimedwait(&pipeMask, NULL, &zero);
+  }
+  sigprocmask(SIG_SETMASK, &existingMask, NULL);
+  workers[i].pending.push_back(num);
+}
+
+/**
+ * Event loop
+ * ----------
+ * Everything farm waits on (more input, workers stopping, workers answering) is
+ * registered with a single epoll instance, so there's exactly one place the program
+ * blocks.  SIGCHLD is blocked and read from a signalfd rather than handled
+ * asynchronously, which is what lets worker stops be just another event.
+ * epoll refuses regular files, so when stdin is redirected from one it's simply
+ * read whenever there's a credit to spend, since such reads never block for long.
+ */
+static const uint64_t kInputEvent = ~0ULL;
+static const uint64_t kChildEvent = ~0ULL - 1;
+
+struct eventLoop {
+  int epollfd;
+  int childfd;         // signalfd for SIGCHLD, or kNotInUse in streaming mode
+  bool inputPollable;  // whether stdin can be registered with epollfd at all
+  bool inputWanted;    // whether stdin is registered with epollfd right now
+  bool inputDone;
+  string input;        // bytes read from stdin but not yet dispatched
+};
+
+static int watch(int epollfd, int op, int fd, uint32_t events, uint64_t tag) {
+  struct epoll_event event;
+  event.events = events;
+  event.data.u64 = tag;
+  return epoll_ctl(epollfd, op, fd, &event);
+}
+
+static void watchInput(eventLoop& loop, bool wanted) {
+  if (!loop.inputPollable || loop.inputWanted == wanted) return;
+  // removed rather than masked when unwanted: a closed pipe reports EPOLLHUP regardless
+  watch(loop.epollfd, wanted ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, STDIN_FILENO, EPOLLIN, kInputEvent);
+  loop.inputWanted = wanted;
+}
+
+static void openEventLoop(eventLoop& loop, bool streaming) {
+  loop.epollfd = epoll_create1(EPOLL_CLOEXEC);
+  exitIf(loop.epollfd == -1, kEventLoopFailed, stderr, "epoll_create1 failed.\n");
+  loop.childfd = kNotInUse;
+  if (!streaming) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    loop.childfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    exitIf(loop.childfd == -1, kEventLoopFailed, stderr, "signalfd failed.\n");
+    watch(loop.epollfd, EPOLL_CTL_ADD, loop.childfd, EPOLLIN, kChildEvent);
+  } else {
+    for (size_t i = 0; i < workers.size(); i++) {
+      watch(loop.epollfd, EPOLL_CTL_ADD, workers[i].sp.ingestfd, EPOLLIN, i);
     }
   }
-  sigprocmask(SIG_UNBLOCK, &additions, NULL); 
-  return worker_available;
+  loop.inputPollable = watch(loop.epollfd, EPOLL_CTL_ADD, STDIN_FILENO, EPOLLIN, kInputEvent) == 0;
+  loop.inputWanted = loop.inputPollable;
+  loop.inputDone = false;
 }
 
-static void broadcastNumbersToWorkers() {
+static void closeEventLoop(eventLoop& loop) {
+  close(loop.epollfd);
+  if (loop.childfd != kNotInUse) close(loop.childfd);
+}
+
+/**
+ * Credits every worker that has stopped since the last time we looked, and retires
+ * every one that has exited.  The signalfd only says that some SIGCHLDs arrived
+ * (several may have been merged into one), so waitpid is what says which workers
+ * they were for.
+ */
+static void reapStoppedWorkers(eventLoop& loop) {
+  struct signalfd_siginfo info;
+  while (read(loop.childfd, &info, sizeof(info)) == sizeof(info));
+  pid_t pid;
   while (true) {
-    string line;
-    getline(cin, line);
-    if (cin.fail())
-    {
-     break;
+    int status;
+    pid = waitpid(-1, &status, WNOHANG | WUNTRACED);
+    if (pid <= 0) break;
+    auto found = workerIndices.find(pid);
+    if (found == workerIndices.end()) continue;
+    size_t i = found->second;
+    if (WIFSTOPPED(status)) {
+      workers[i].pending.clear();
+      credits.push_back(i);
+    } else {
+      retireWorker(i);
     }
-    size_t endpos;
-    long long num = stoll(line, &endpos);
-    if (endpos != line.size()) break;
-    size_t index_available = getAvailableWorker();
-    dprintf(workers[index_available].sp.supplyfd, "%lld\n", num);
-    kill(workers[index_available].sp.pid, SIGCONT);
   }
+  exitUnless(pid == 0 || errno == ECHILD, kWaitFailed, stderr, "waitpid failed within reapStoppedWorkers.\n");
 }
 
-static void waitForAllWorkers()
-{
-  for (size_t i = 0; i < kNumCPUs; i++)
-  {
-    getAvailableWorker();
+/**
+ * Reads whatever output worker i has produced, passing each complete line along to
+ * stdout and crediting the worker for it.  Once the worker has closed its end, the
+ * descriptor is closed as well and set to kNotInUse, and the worker is retired.
+ */
+static void collectAnswers(size_t i) {
+  char buffer[4096];
+  ssize_t count = read(workers[i].sp.ingestfd, buffer, sizeof(buffer));
+  if (count == -1 && errno == EINTR) return;
+  if (count <= 0) {
+    close(workers[i].sp.ingestfd); // also drops it from the epoll set
+    workers[i].sp.ingestfd = kNotInUse;
+    retireWorker(i);
+    return;
+  }
+  workers[i].partial.append(buffer, count);
+  size_t start = 0;
+  while (true) {
+    size_t newline = workers[i].partial.find('\n', start);
+    if (newline == string::npos) break;
+    cout.write(workers[i].partial.data() + start, newline + 1 - start);
+    if (!workers[i].pending.empty()) {
+      workers[i].pending.pop_front();
+      credits.push_back(i);
+    }
+    start = newline + 1;
   }
+  workers[i].partial.erase(0, start);
+  cout.flush();
+}
+
+/**
+ * Blocks until something happens (or returns right away if block is false) and
+ * handles whatever did.  Returns true if stdin has input waiting.
+ */
+static bool waitForEvents(eventLoop& loop, bool block) {
+  struct epoll_event events[64];
+  int count = epoll_wait(loop.epollfd, events, 64, block ? -1 : 0);
+  if (count == -1 && errno == EINTR) return false;
+  exitIf(count == -1, kEventLoopFailed, stderr, "epoll_wait failed.\n");
+  bool inputReady = false;
+  for (int e = 0; e < count; e++) {
+    if (events[e].data.u64 == kInputEvent) inputReady = true;
+    else if (events[e].data.u64 == kChildEvent) reapStoppedWorkers(loop);
+    else collectAnswers(events[e].data.u64);
+  }
+  return inputReady;
+}
+
+/**
+ * Pulls the next number off of stdin, reading more only when what's already buffered
+ * doesn't hold a full line.  Returns false if there's no full line just yet, and
+ * sets inputDone at end of file or at the first line that isn't a number.
+ */
+static bool nextNumber(eventLoop& loop, bool inputReady, long long& num) {
+  while (true) {
+    size_t newline = loop.input.find('\n');
+    if (newline != string::npos || (loop.inputDone && !loop.input.empty())) {
+      string line = loop.input.substr(0, newline);
+      loop.input.erase(0, newline == string::npos ? string::npos : newline + 1);
+      char *end;
+      errno = 0;
+      num = strtoll(line.c_str(), &end, 10);
+      if (line.empty() || *end != '\0' || errno != 0) {
+        loop.inputDone = true;
+        loop.input.clear();
+        return false;
+      }
+      return true;
+    }
+    if (loop.inputDone || (loop.inputPollable && !inputReady)) return false;
+    char buffer[4096];
+    ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) loop.inputDone = true;
+    else loop.input.append(buffer, count);
+    inputReady = false; // a pipe may have had only part of a line for us
+  }
+}
+
+/**
+ * Hands out numbers until stdin runs dry, or until there are no workers left to
+ * hand them to, in which case it returns false.
+ */
+static bool dispatchNumbers(eventLoop& loop, bool streaming) {
+  bool inputReady = false;
+  while (!loop.inputDone) {
+    long long num;
+    while (!credits.empty() && nextNumber(loop, inputReady, num)) {
+      size_t i = credits.front();
+      credits.pop_front();
+      sendNumber(i, num);
+      if (!streaming) kill(workers[i].sp.pid, SIGCONT);
+      inputReady = false;
+    }
+    if (loop.inputDone) break;
+    if (numLiveWorkers == 0) {
+      cerr << "No workers are left to answer the rest of the input." << endl;
+      watchInput(loop, false);
+      return false;
+    }
+    // with no credits, wait on the workers alone; otherwise stdin is what we need
+    watchInput(loop, !credits.empty());
+    inputReady = waitForEvents(loop, credits.empty() || loop.inputPollable) || inputReady;
+  }
+  watchInput(loop, false);
+  return true;
+}
+
+static void waitForAllWorkers(eventLoop& loop) {
+  while (credits.size() < numLiveWorkers) waitForEvents(loop, true);
 }
 
 static void closeAllWorkers() {
   signal(SIGCHLD, SIG_DFL);
-  
-  for (size_t child = 0; child < kNumCPUs; child++)
+
+  // retired workers have already been reaped, so their pids may not be theirs anymore
+  for (size_t child = 0; child < workers.size(); child++)
   {
+    if (workers[child].sp.supplyfd == kNotInUse) continue;
     close(workers[child].sp.supplyfd);
     kill(workers[child].sp.pid, SIGCONT);
   }
 
-  for (size_t i = 0; i < kNumCPUs; i++)
+  for (size_t i = 0; i < numLiveWorkers; i++)
   {
     waitpid(-1, NULL, 0);
   }
 
 }
 
+/**
+ * Sends every streaming worker an EOF, relays everything they still have to say,
+ * and waits for all of them to exit.
+ */
+static void closeAllStreamingWorkers(eventLoop& loop) {
+  for (size_t i = 0; i < workers.size(); i++) {
+    if (workers[i].sp.supplyfd == kNotInUse) continue;
+    close(workers[i].sp.supplyfd);
+    workers[i].sp.supplyfd = kNotInUse;
+  }
+  while (numLiveWorkers > 0) waitForEvents(loop, true);
+  for (size_t i = 0; i < workers.size(); i++) waitpid(workers[i].sp.pid, NULL, 0);
+}
+
+static void printUsage(const char *progname) {
+  cerr << "Usage: " << progname << " [--worker <executable>] [--workers <count>] [--streaming [--window <credits>]]" << endl;
+}
+
 int main(int argc, char *argv[]) {
-  signal(SIGCHLD, markWorkersAsAvailable);
-  spawnAllWorkers();
-  broadcastNumbersToWorkers();
-  waitForAllWorkers();
-  closeAllWorkers();
-  return 0;
+  bool streaming = false;
+  size_t window = kDefaultCreditWindow;
+  size_t numWorkers = kNumCPUs;
+  const char *workerPath = kDefaultWorker;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--streaming") == 0) {
+      streaming = true;
+    } else if (strcmp(argv[i], "--worker") == 0 && i + 1 < argc) {
+      workerPath = argv[++i];
+    } else if ((strcmp(argv[i], "--window") == 0 || strcmp(argv[i], "--workers") == 0) && i + 1 < argc) {
+      char *end;
+      size_t value = strtoul(argv[i + 1], &end, 10);
+      if (*end != '\0' || value == 0) {
+        printUsage(argv[0]);
+        return 1;
+      }
+      if (strcmp(argv[i], "--window") == 0) window = value;
+      else numWorkers = value;
+      i++;
+    } else {
+      printUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  spawnAllWorkers(workerPath, numWorkers, streaming);
+  eventLoop loop;
+  openEventLoop(loop, streaming);
+  if (streaming) {
+    // deal the credits out round-robin, so the first numbers spread across every worker
+    for (size_t c = 0; c < window; c++) {
+      for (size_t i = 0; i < workers.size(); i++) credits.push_back(i);
+    }
+  } else {
+    // workers that stopped before SIGCHLD was blocked left no trace in the signalfd
+    reapStoppedWorkers(loop);
+  }
+  bool inputDispatched = dispatchNumbers(loop, streaming);
+  if (streaming) {
+    closeAllStreamingWorkers(loop);
+  } else {
+    waitForAllWorkers(loop);
+    closeAllWorkers();
+  }
+  closeEventLoop(loop);
+  return inputDispatched && numUnanswered == 0 ? 0 : kNumbersUnanswered;
 }
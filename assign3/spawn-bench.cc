@@ -0,0 +1,115 @@
+/**
+ * File: spawn-bench.cc
+ * --------------------
+ * Measures how many subprocesses per second can be launched (and reaped) as the
+ * parent's resident set grows, comparing subprocess, which spawns with posix_spawnp,
+ * against the fork-and-execvp approach it used to take.  fork has to copy the
+ * parent's page tables, so its cost climbs with the parent's size, whereas a
+ * vfork-style spawn borrows the parent's address space and shouldn't notice.
+ *
+ * Each child is /bin/true with both its stdin and stdout piped, just as farm's
+ * workers are.  The resident set sizes (in MiB) can be given on the command line.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "subprocess.h"
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kAllocationFailed = 2;
+static const size_t kDefaultSizes[] = {0, 64, 256, 1024, 2048};
+static const int kNumSpawns = 200;
+static const char *kChildArguments[] = {"/bin/true", NULL};
+
+/**
+ * Function: forkAndExec
+ * ---------------------
+ * What subprocess used to do, minus the error checking: fork, wire up
+ * the pipes in the child, and execvp.
+ */
+static subprocess_t forkAndExec(char *argv[]) {
+  int supplyfds[2], ingestfds[2];
+  pipe(supplyfds);
+  pipe(ingestfds);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(supplyfds[1]);
+    dup2(supplyfds[0], STDIN_FILENO);
+    close(supplyfds[0]);
+    close(ingestfds[0]);
+    dup2(ingestfds[1], STDOUT_FILENO);
+    close(ingestfds[1]);
+    execvp(argv[0], argv);
+    _exit(1);
+  }
+  close(supplyfds[0]);
+  close(ingestfds[1]);
+  subprocess_t process = {pid, supplyfds[1], ingestfds[0]};
+  return process;
+}
+
+/**
+ * Function: timeSpawns
+ * --------------------
+ * Launches, closes up, and reaps kNumSpawns children one at a time,
+ * and returns the number launched per second.
+ */
+template <typename Spawn>
+static double timeSpawns(Spawn spawn) {
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < kNumSpawns; i++) {
+    subprocess_t sp = spawn(const_cast<char **>(kChildArguments));
+    close(sp.supplyfd);
+    close(sp.ingestfd);
+    waitpid(sp.pid, NULL, 0);
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return kNumSpawns / elapsed.count();
+}
+
+static subprocess_t spawn(char *argv[]) {
+  return subprocess(argv, true, true);
+}
+
+int main(int argc, char *argv[]) {
+  vector<size_t> sizes;
+  for (int i = 1; i < argc; i++) {
+    char *end;
+    sizes.push_back(strtoul(argv[i], &end, 10));
+    if (*end != '\0') {
+      cerr << "Usage: " << argv[0] << " [<resident-MiB> ...]" << endl;
+      return kWrongArgumentCount;
+    }
+  }
+  if (sizes.empty()) sizes.assign(begin(kDefaultSizes), end(kDefaultSizes));
+
+  cout << setw(10) << "parent" << setw(18) << "fork+execvp" << setw(18) << "posix_spawnp" << endl;
+  for (size_t mebibytes : sizes) {
+    // touch every page, so the memory is really resident and really mapped
+    size_t length = mebibytes << 20;
+    void *ballast = NULL;
+    if (length > 0) {
+      ballast = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (ballast == MAP_FAILED) {
+        cerr << "Couldn't allocate " << mebibytes << " MiB.  Aborting..." << endl;
+        return kAllocationFailed;
+      }
+      memset(ballast, 1, length);
+    }
+    double forked = timeSpawns(forkAndExec);
+    double spawned = timeSpawns(spawn);
+    cout << setw(6) << mebibytes << " MiB" << fixed << setprecision(1)
+         << setw(11) << forked << " /sec" << setw(13) << spawned << " /sec"
+         << "  (" << spawned / forked << "x)" << endl;
+    if (ballast != NULL) munmap(ballast, length);
+  }
+  return 0;
+}
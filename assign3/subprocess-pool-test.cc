@@ -0,0 +1,123 @@
+/**
+ * File: subprocess-pool-test.cc
+ * -----------------------------
+ * Exercises the SubprocessPool class with factor workers, and compares it against
+ * what callers do without one: run a fresh subprocess per request.  Requests are
+ * issued by several threads at once so the pool's queue actually fills, and one
+ * request is garbage, which factor answers by exiting, so the restart path gets
+ * exercised too.  Every answer the pool gives is checked against the answer the
+ * per-request subprocesses gave.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <ext/stdio_filebuf.h>
+#include "subprocess-pool.h"
+
+using namespace __gnu_cxx; // __gnu_cxx::stdio_filebuf -> stdio_filebuf
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kAnswersDiffer = 2;
+static const size_t kDefaultNumWorkers = 4;
+static const size_t kDefaultNumRequests = 2000;
+static const size_t kNumClientThreads = 8;
+static const char *kWorkerArguments[] = {"./factor", NULL};
+static const char *kPooledWorkerArguments[] = {"./factor", "--pool", NULL};
+
+/**
+ * Function: stripTiming
+ * ---------------------
+ * Drops the pid and time factor appends to every answer, which naturally differ
+ * from one run to the next.
+ */
+static string stripTiming(const string& answer) {
+  return answer.substr(0, answer.find(" [pid:"));
+}
+
+/**
+ * Function: askFreshSubprocess
+ * ----------------------------
+ * Answers one request the old way: spawn a worker, hand it the number, read its
+ * one line of output, and wait for it to exit.
+ */
+static string askFreshSubprocess(const string& number) {
+  subprocess_t sp = subprocess(const_cast<char **>(kWorkerArguments), true, true);
+  dprintf(sp.supplyfd, "%s\n", number.c_str());
+  close(sp.supplyfd);
+  stdio_filebuf<char> inbuf(sp.ingestfd, ios::in);
+  istream is(&inbuf);
+  string answer;
+  getline(is, answer);
+  waitpid(sp.pid, NULL, 0);
+  return answer;
+} // stdio_filebuf destroyed, destructor closes ingestfd
+
+static void printStats(const subprocessPoolStats& stats) {
+  cout << "  workers: " << stats.numWorkers << ", answered: " << stats.numRequests
+       << ", failed: " << stats.numFailures << ", restarts: " << stats.numRestarts << endl;
+  cout << "  queue depth: " << stats.queueDepth << " now, " << stats.maxQueueDepth << " at most" << endl;
+  cout << fixed << setprecision(1)
+       << "  latency: " << stats.meanLatency * 1e6 << "us mean, " << stats.maxLatency * 1e6 << "us max"
+       << " (queued " << stats.meanQueueTime * 1e6 << "us mean, " << stats.maxQueueTime * 1e6 << "us max)" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc > 3) {
+    cerr << "Usage: " << argv[0] << " [<num-workers> [<num-requests>]]" << endl;
+    return kWrongArgumentCount;
+  }
+  size_t numWorkers = argc > 1 ? strtoul(argv[1], NULL, 10) : kDefaultNumWorkers;
+  size_t numRequests = argc > 2 ? strtoul(argv[2], NULL, 10) : kDefaultNumRequests;
+  vector<string> numbers;
+  for (size_t i = 0; i < numRequests; i++) numbers.push_back(to_string(1000003ULL * (i + 1) + i));
+
+  vector<string> expected(numRequests);
+  auto start = chrono::steady_clock::now();
+  for (size_t i = 0; i < numRequests; i++) expected[i] = stripTiming(askFreshSubprocess(numbers[i]));
+  chrono::duration<double> freshTime = chrono::steady_clock::now() - start;
+  cout << "Subprocess per request: " << fixed << setprecision(1) << numRequests / freshTime.count()
+       << " requests/sec." << endl;
+
+  SubprocessPool pool(const_cast<char **>(kPooledWorkerArguments), numWorkers);
+  vector<string> answers(numRequests);
+  bool garbageRejected = false;
+  start = chrono::steady_clock::now();
+  vector<thread> clients;
+  for (size_t t = 0; t < kNumClientThreads; t++) {
+    clients.push_back(thread([&, t] {
+      for (size_t i = t; i < numRequests; i += kNumClientThreads) {
+        answers[i] = stripTiming(pool.request(numbers[i]));
+        if (i == numRequests / 2) {
+          try {
+            pool.request("garbage");
+          } catch (const SubprocessException& se) {
+            garbageRejected = true;
+          }
+        }
+      }
+    }));
+  }
+  for (thread& client : clients) client.join();
+  chrono::duration<double> pooledTime = chrono::steady_clock::now() - start;
+  cout << "Subprocess pool: " << fixed << setprecision(1) << numRequests / pooledTime.count()
+       << " requests/sec (" << freshTime.count() / pooledTime.count() << "x)." << endl;
+  printStats(pool.getStats());
+
+  if (!garbageRejected) cout << "The garbage request was answered!" << endl;
+  for (size_t i = 0; i < numRequests; i++) {
+    if (answers[i] != expected[i]) {
+      cout << "Answers differ for " << numbers[i] << ": \"" << expected[i] << "\" vs \"" << answers[i] << "\"" << endl;
+      return kAnswersDiffer;
+    }
+  }
+  cout << "All " << numRequests << " answers match." << endl;
+  return 0;
+}
@@ -0,0 +1,203 @@
+/**
+ * File: subprocess-pool.cc
+ * ------------------------
+ * Presents the implementation of the SubprocessPool class and its framing.
+ *
+ * A request is handled entirely by the calling thread: the lock is held only long
+ * enough to claim an idle worker off the free list (and later to give it back and
+ * update the statistics), so requests to different workers proceed in parallel.
+ */
+
+#include "subprocess-pool.h"
+#include <algorithm>
+#include <csignal>
+#include <cerrno>
+#include <ctime>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+static bool writeAll(int fd, const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t count = write(fd, data, length);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    data += count;
+    length -= count;
+  }
+  return true;
+}
+
+static bool readAll(int fd, char *data, size_t length) {
+  while (length > 0) {
+    ssize_t count = read(fd, data, length);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) return false;
+    data += count;
+    length -= count;
+  }
+  return true;
+}
+
+bool readFrame(int fd, string& payload) {
+  uint32_t length;
+  if (!readAll(fd, (char *) &length, sizeof(length))) return false;
+  payload.resize(ntohl(length));
+  return readAll(fd, &payload[0], payload.size());
+}
+
+bool writeFrame(int fd, const string& payload) {
+  // header and payload go out in one write, so small frames cost a single system call
+  uint32_t length = htonl(payload.size());
+  string frame((const char *) &length, sizeof(length));
+  frame += payload;
+  return writeAll(fd, frame.data(), frame.size());
+}
+
+SubprocessPool::SubprocessPool(char *argv[], size_t numWorkers) throw (SubprocessException) :
+  workers(numWorkers), queueDepth(0), maxQueueDepth(0), numRequests(0), numFailures(0), numRestarts(0),
+  totalLatency(0), maxLatency(0), totalQueueTime(0), maxQueueTime(0) {
+  for (size_t i = 0; argv[i] != NULL; i++) arguments.push_back(argv[i]);
+  for (string& argument : arguments) this->argv.push_back(&argument[0]);
+  this->argv.push_back(NULL);
+  for (size_t i = 0; i < numWorkers; i++) {
+    startWorker(i);
+    idle.push_back(i);
+  }
+}
+
+SubprocessPool::~SubprocessPool() {
+  for (const subprocess_t& sp : workers) {
+    if (sp.pid != kNotInUse) close(sp.supplyfd);
+  }
+  for (const subprocess_t& sp : workers) {
+    if (sp.pid == kNotInUse) continue;
+    waitpid(sp.pid, NULL, 0);
+    close(sp.ingestfd);
+  }
+}
+
+void SubprocessPool::startWorker(size_t i) {
+  workers[i] = subprocess(argv.data(), true, true);
+}
+
+/**
+ * Replaces worker i, killing it first unless it's already been reaped.  Only the
+ * thread that has claimed worker i calls this, so its entry needn't be locked.  If
+ * the replacement can't be started, the entry is left empty (its pid kNotInUse),
+ * and the next request to claim it tries again.
+ */
+void SubprocessPool::restartWorker(size_t i, bool reaped) {
+  if (workers[i].pid != kNotInUse) {
+    if (!reaped) {
+      kill(workers[i].pid, SIGKILL);
+      waitpid(workers[i].pid, NULL, 0);
+    }
+    close(workers[i].supplyfd);
+    close(workers[i].ingestfd);
+    workers[i] = {kNotInUse, kNotInUse, kNotInUse};
+  }
+  startWorker(i);
+  lock_guard<mutex> lg(m);
+  numRestarts++;
+}
+
+/**
+ * Sends one request to worker i and reads its response, returning false if the
+ * worker couldn't take the request or went away before answering.  SIGPIPE is
+ * blocked while writing, so a dead worker shows up as EPIPE rather than taking the
+ * whole program down, and any SIGPIPE that raises is consumed before it's unblocked.
+ */
+bool SubprocessPool::exchange(size_t i, const string& payload, string& response) {
+  sigset_t pipeMask, existingMask;
+  sigemptyset(&pipeMask);
+  sigaddset(&pipeMask, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipeMask, &existingMask);
+  bool sent = writeFrame(workers[i].supplyfd, payload);
+  if (!sent && errno == EPIPE) {
+    struct timespec zero = {0, 0};
+    sigtimedwait(&pipeMask, NULL, &zero);
+  }
+  pthread_sigmask(SIG_SETMASK, &existingMask, NULL);
+  return sent && readFrame(workers[i].ingestfd, response);
+}
+
+string SubprocessPool::request(const string& payload) throw (SubprocessException) {
+  auto submitted = chrono::steady_clock::now();
+  size_t i;
+  {
+    unique_lock<mutex> ul(m);
+    queueDepth++;
+    maxQueueDepth = max(maxQueueDepth, queueDepth);
+    cv.wait(ul, [this] { return !idle.empty(); });
+    queueDepth--;
+    i = idle.back();
+    idle.pop_back();
+  }
+  chrono::duration<double> queueTime = chrono::steady_clock::now() - submitted;
+
+  string response;
+  bool answered;
+  try {
+    // a worker that died while idle (or never got restarted) is replaced before it's
+    // handed anything.  waitpid fails outright if the caller ignores SIGCHLD or reaps
+    // children itself, which says nothing about the worker, so that case is left to
+    // the EPIPE/EOF handling below
+    if (workers[i].pid == kNotInUse || waitpid(workers[i].pid, NULL, WNOHANG) > 0) restartWorker(i, true);
+    answered = exchange(i, payload, response);
+    if (!answered) {
+      restartWorker(i, false);
+      answered = exchange(i, payload, response);
+      if (!answered) restartWorker(i, false);
+    }
+  } catch (const SubprocessException& se) {
+    // the worker couldn't be replaced, but its entry still goes back on the free list,
+    // or the pool would shrink by one for good
+    finishRequest(i, false, queueTime, chrono::steady_clock::now() - submitted);
+    throw;
+  }
+  finishRequest(i, answered, queueTime, chrono::steady_clock::now() - submitted);
+  if (!answered) throw SubprocessException("No worker could answer the request.\n");
+  return response;
+}
+
+/**
+ * Puts worker i back on the free list and records how the request it was
+ * claimed for went.
+ */
+void SubprocessPool::finishRequest(size_t i, bool answered, chrono::duration<double> queueTime,
+                                   chrono::duration<double> latency) {
+  {
+    lock_guard<mutex> lg(m);
+    idle.push_back(i);
+    if (answered) {
+      numRequests++;
+      totalLatency += latency;
+      maxLatency = max(maxLatency, latency);
+      totalQueueTime += queueTime;
+      maxQueueTime = max(maxQueueTime, queueTime);
+    } else {
+      numFailures++;
+    }
+  }
+  cv.notify_one();
+}
+
+subprocessPoolStats SubprocessPool::getStats() {
+  lock_guard<mutex> lg(m);
+  subprocessPoolStats stats;
+  stats.numWorkers = workers.size();
+  stats.queueDepth = queueDepth;
+  stats.maxQueueDepth = maxQueueDepth;
+  stats.numRequests = numRequests;
+  stats.numFailures = numFailures;
+  stats.numRestarts = numRestarts;
+  stats.meanLatency = numRequests == 0 ? 0 : totalLatency.count() / numRequests;
+  stats.maxLatency = maxLatency.count();
+  stats.meanQueueTime = numRequests == 0 ? 0 : totalQueueTime.count() / numRequests;
+  stats.maxQueueTime = maxQueueTime.count();
+  return stats;
+}
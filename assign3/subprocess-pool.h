@@ -0,0 +1,100 @@
+/**
+ * File: subprocess-pool.h
+ * -----------------------
+ * Exports the SubprocessPool class, which keeps a fixed number of long-lived worker
+ * processes (all created via subprocess and all running the same command) and hands
+ * each request to an idle one.  Callers that would otherwise run a fresh process per
+ * request pay for fork, exec, and whatever start-up work the worker does once per
+ * worker instead.
+ *
+ * Requests and responses travel over each worker's supply and ingest pipes as frames:
+ * a four-byte length, in network byte order, followed by that many bytes of payload.
+ * A worker reads request frames from its stdin and writes exactly one response frame
+ * to its stdout per request, in order, until it reads EOF.  readFrame and writeFrame
+ * are exported so workers needn't reimplement the framing.
+ *
+ * Workers that die are restarted: before a request is sent, if the chosen worker has
+ * exited, and after a request, if the worker went away without answering (in which
+ * case the request is retried once on the replacement).  A replacement that can't be
+ * started fails the request, and is tried again by the next request to need it.
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "subprocess.h"
+
+/**
+ * Functions: readFrame, writeFrame
+ * --------------------------------
+ * Read or write one length-prefixed frame, returning false on EOF or error.
+ */
+bool readFrame(int fd, std::string& payload);
+bool writeFrame(int fd, const std::string& payload);
+
+/**
+ * Type: subprocessPoolStats
+ * -------------------------
+ * A snapshot of a pool's activity.  Latencies are in seconds, and run from the
+ * moment a request is submitted until its response is read, so they include any
+ * time spent queued waiting for an idle worker (which is also tallied on its own).
+ */
+struct subprocessPoolStats {
+  size_t numWorkers;
+  size_t queueDepth;      // requests waiting for a worker right now
+  size_t maxQueueDepth;
+  size_t numRequests;     // requests answered
+  size_t numFailures;     // requests that couldn't be answered even after a restart
+  size_t numRestarts;     // workers replaced after dying
+  double meanLatency, maxLatency;
+  double meanQueueTime, maxQueueTime;
+};
+
+class SubprocessPool {
+ public:
+
+/**
+ * Starts numWorkers workers, each running the command in argv (which, as with
+ * subprocess, is NULL-terminated).
+ */
+  SubprocessPool(char *argv[], size_t numWorkers) throw (SubprocessException);
+
+/**
+ * Sends every worker EOF and waits for all of them to exit.
+ */
+  ~SubprocessPool();
+
+/**
+ * Sends the request to the next idle worker, waiting for one if they're all busy,
+ * and returns its response.  Safe to call from any number of threads at once.
+ * Throws a SubprocessException if no worker could answer it.
+ */
+  std::string request(const std::string& payload) throw (SubprocessException);
+
+  subprocessPoolStats getStats();
+
+ private:
+  void startWorker(size_t i);
+  void restartWorker(size_t i, bool reaped);
+  bool exchange(size_t i, const std::string& payload, std::string& response);
+  void finishRequest(size_t i, bool answered, std::chrono::duration<double> queueTime,
+                     std::chrono::duration<double> latency);
+
+  std::vector<std::string> arguments;
+  std::vector<char *> argv;   // points into arguments, NULL-terminated
+  std::vector<subprocess_t> workers;
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::vector<size_t> idle;   // free list of worker indices
+  size_t queueDepth, maxQueueDepth;
+  size_t numRequests, numFailures, numRestarts;
+  std::chrono::duration<double> totalLatency, maxLatency;
+  std::chrono::duration<double> totalQueueTime, maxQueueTime;
+
+  SubprocessPool(const SubprocessPool& original) = delete;
+  SubprocessPool& operator=(const SubprocessPool& rhs) = delete;
+};
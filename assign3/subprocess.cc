@@ -2,13 +2,28 @@
  * File: subprocess.cc
  * -------------------
  * Presents the implementation of the subprocess routine.
+ *
+ * Children are launched with posix_spawnp, which glibc implements with
+ * clone(CLONE_VM | CLONE_VFORK): the child borrows the parent's address space
+ * until it execs, so nothing has to copy the parent's page tables, and a spawn
+ * costs the same whether the parent is tiny or has gigabytes mapped.  The pipe
+ * wiring a forked child would do for itself is instead described up front as
+ * spawn file actions.
+ *
+ * The pipes themselves are created close-on-exec, so the parent's ends never leak
+ * into this or any later child; the dup2 file actions clear the flag on the copies
+ * that become the child's stdin and stdout.
  */
 
 #include "subprocess.h"
 #include "exit-utils.h"
+#include <fcntl.h>
+#include <spawn.h>
 
 using namespace std;
 
+extern char **environ;
+
 static const int kExecFailed = 1;
 
 static void dup2wrapper(int fd1, int fd2)
@@ -27,38 +42,26 @@ static void closefd(int fd)
 
 static void pipewrapper(int fds[])
 {
-  int err = pipe(fds);
+  int err = pipe2(fds, O_CLOEXEC);
   if (err == -1) throw(SubprocessException("Pipe failed.\n"));
   return;
 }
 
-subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException) {
-  int supplyfds[2] = {kNotInUse};
-  int ingestfds[2] = {kNotInUse};
- 
-  int supplyfd = kNotInUse;
-  int ingestfd = kNotInUse;
-  
-  if (supplyChildInput)
-  {
-    pipewrapper(supplyfds);
-    //supplyfd: fd you write to would be the write end of the supply pipe
-    //child will read from the read end of the supply pipe
-    supplyfd = supplyfds[1];
-  }
-  if(ingestChildOutput)
-  {
-    pipewrapper(ingestfds);
-    //ingestfd: fd you read from would be the read end of the ingest pipe
-    //child would write to the write end of the ingest pipe
-    ingestfd = ingestfds[0];
-  }
-  
+/**
+ * Function: forkSubprocess
+ * ------------------------
+ * The original fork-and-exec implementation, now only used when posix_spawnp can't
+ * launch argv[0] at all.  Spawn reports that as an error, whereas a forked child
+ * reports it by printing an error and exiting, which is the behavior callers of
+ * subprocess have always seen, so this preserves it.
+ */
+static pid_t forkSubprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput,
+                            int supplyfds[], int ingestfds[])
+{
   pid_t pid = fork();
   if (pid == -1) throw(SubprocessException("Fork failed.\n"));
   
-  subprocess_t process = {pid, supplyfd, ingestfd};
-  if (process.pid == 0)
+  if (pid == 0)
   {
     //enable: parent process to pipe content to the new process's stdin
     if(supplyChildInput)
@@ -84,6 +87,54 @@ subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOut
     execvp(argv[0], argv);
     exitIf(true, kExecFailed, stderr, "execvp failed.");
   }
+  return pid;
+}
+
+/**
+ * Function: spawnSubprocess
+ * -------------------------
+ * Launches argv[0] via posix_spawnp, with file actions that make the supply pipe's
+ * read end the child's stdin and the ingest pipe's write end its stdout.  Returns
+ * the child's pid, or -1 if it couldn't be launched.
+ */
+static pid_t spawnSubprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput,
+                             int supplyfds[], int ingestfds[])
+{
+  posix_spawn_file_actions_t actions;
+  if (posix_spawn_file_actions_init(&actions) != 0) return -1;
+  if (supplyChildInput) posix_spawn_file_actions_adddup2(&actions, supplyfds[0], STDIN_FILENO);
+  if (ingestChildOutput) posix_spawn_file_actions_adddup2(&actions, ingestfds[1], STDOUT_FILENO);
+  pid_t pid;
+  int err = posix_spawnp(&pid, argv[0], &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  return err == 0 ? pid : -1;
+}
+
+subprocess_t subprocess(char *argv[], bool supplyChildInput, bool ingestChildOutput) throw (SubprocessException) {
+  int supplyfds[2] = {kNotInUse};
+  int ingestfds[2] = {kNotInUse};
+ 
+  int supplyfd = kNotInUse;
+  int ingestfd = kNotInUse;
+  
+  if (supplyChildInput)
+  {
+    pipewrapper(supplyfds);
+    //supplyfd: fd you write to would be the write end of the supply pipe
+    //child will read from the read end of the supply pipe
+    supplyfd = supplyfds[1];
+  }
+  if(ingestChildOutput)
+  {
+    pipewrapper(ingestfds);
+    //ingestfd: fd you read from would be the read end of the ingest pipe
+    //child would write to the write end of the ingest pipe
+    ingestfd = ingestfds[0];
+  }
+
+  pid_t pid = spawnSubprocess(argv, supplyChildInput, ingestChildOutput, supplyfds, ingestfds);
+  if (pid == -1) pid = forkSubprocess(argv, supplyChildInput, ingestChildOutput, supplyfds, ingestfds);
+  subprocess_t process = {pid, supplyfd, ingestfd};
   if (supplyChildInput) 
   {
     closefd(supplyfds[0]);
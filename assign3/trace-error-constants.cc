@@ -34,8 +34,13 @@
 
 #include "trace-error-constants.h"
 #include <fstream>
+#include <sstream>
 #include <regex>
 #include <cassert>
+#include <cstdint>
+#include <vector>
+#include <cstring>
+#include <sys/stat.h>
 using namespace std;
 
 /**
@@ -61,8 +66,7 @@ static const string kErrorConstantDefinePattern = "[^E]*(E\\S*)\\s+(\\d+).*";
  * then the function returns without modifying the map.  If it succeeds, then a new pair<int, string>
  * is added to the supplied map.
  */
-static void processLine(map<int, string>& errorConstants, const string& line) {
-  regex re(kErrorConstantDefinePattern); // all constants we're interested in begin with E
+static void processLine(map<int, string>& errorConstants, const string& line, const regex& re) {
   smatch sm;
   if (!regex_match(line, sm, re)) return;
   assert(sm.size() == 3);
@@ -71,13 +75,104 @@ static void processLine(map<int, string>& errorConstants, const string& line) {
   errorConstants[num] = str;
 }
 
+/**
+ * Constants: kCacheFilename, kCacheMagic
+ * --------------------------------------
+ * The binary cache is laid out as kCacheMagic, then the size and modification time of each of
+ * kErrorHeaderFilenames (as two int64_ts apiece), then the number of constants (an int32_t),
+ * and then for each constant its errno value and name length (two int32_ts) followed by the
+ * name itself.  The cache is only trusted if every header's size and modification time still match.
+ */
+static const string kCacheFilename = ".trace_error_constants";
+static const char kCacheMagic[8] = {'T', 'R', 'E', 'R', 'R', 'N', 'O', '1'};
+
+/**
+ * Function: headerStamps
+ * ----------------------
+ * Returns the sizes and modification times of all of kErrorHeaderFilenames, in the order
+ * they're written to the cache.
+ */
+static vector<int64_t> headerStamps() throw (MissingFileException) {
+  vector<int64_t> stamps;
+  for (const string& name: kErrorHeaderFilenames) {
+    struct stat st;
+    if (stat(name.c_str(), &st) == -1)
+      throw MissingFileException("Failed to open the file named \"" + name + "\".");
+    stamps.push_back(st.st_size);
+    stamps.push_back(st.st_mtime);
+  }
+  return stamps;
+}
+
+/**
+ * Function: loadFromCache
+ * -----------------------
+ * Populates errorConstants from the binary cache and returns true, or returns false
+ * (leaving errorConstants empty) if there's no cache or it's stale or malformed.
+ */
+static bool loadFromCache(map<int, string>& errorConstants, const vector<int64_t>& stamps) {
+  ifstream cache(kCacheFilename, ios::binary);
+  if (cache.fail()) return false;
+  ostringstream contents;
+  contents << cache.rdbuf();
+  const string data = contents.str();
+
+  size_t pos = 0;
+  auto read = [&](void *dest, size_t length) {
+    if (data.size() - pos < length) return false;
+    memcpy(dest, data.data() + pos, length);
+    pos += length;
+    return true;
+  };
+
+  char magic[sizeof(kCacheMagic)];
+  vector<int64_t> cachedStamps(stamps.size());
+  int32_t count;
+  if (!read(magic, sizeof(magic)) || memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+      !read(cachedStamps.data(), cachedStamps.size() * sizeof(int64_t)) || cachedStamps != stamps ||
+      !read(&count, sizeof(count))) return false;
+  for (int32_t i = 0; i < count; i++) {
+    int32_t entry[2];
+    if (!read(entry, sizeof(entry)) || entry[1] < 0 || data.size() - pos < (size_t) entry[1]) {
+      errorConstants.clear();
+      return false;
+    }
+    errorConstants[entry[0]] = data.substr(pos, entry[1]);
+    pos += entry[1];
+  }
+  return true;
+}
+
+/**
+ * Function: saveToCache
+ * ---------------------
+ * Writes errorConstants to the binary cache.  Failing to is harmless, since the
+ * headers can always be parsed again next time, so failures are ignored.
+ */
+static void saveToCache(const map<int, string>& errorConstants, const vector<int64_t>& stamps) {
+  ofstream cache(kCacheFilename, ios::binary | ios::trunc);
+  cache.write(kCacheMagic, sizeof(kCacheMagic));
+  cache.write((const char *) stamps.data(), stamps.size() * sizeof(int64_t));
+  int32_t count = errorConstants.size();
+  cache.write((const char *) &count, sizeof(count));
+  for (const auto& p: errorConstants) {
+    int32_t entry[2] = {p.first, (int32_t) p.second.size()};
+    cache.write((const char *) entry, sizeof(entry));
+    cache.write(p.second.data(), p.second.size());
+  }
+}
+
 /**
  * Function: compileSystemCallErrorStrings
  * ---------------------------------------
  * Crawls over the files listed in kErrorHeaderFilenames and populates the
- * supplied map with all of the errno #define constants (like ENOENT, ECHILD, EACCES, etc).
+ * supplied map with all of the errno #define constants (like ENOENT, ECHILD, EACCES, etc),
+ * unless the binary cache already holds them.
  */
 void compileSystemCallErrorStrings(map<int, string>& errorConstants) throw (MissingFileException) {
+  vector<int64_t> stamps = headerStamps();
+  if (loadFromCache(errorConstants, stamps)) return;
+  regex re(kErrorConstantDefinePattern); // all constants we're interested in begin with E
   for (const string& name: kErrorHeaderFilenames) {
     ifstream infile(name);
     if (infile.fail()) 
@@ -87,7 +182,8 @@ void compileSystemCallErrorStrings(map<int, string>& errorConstants) throw (Miss
       string line;
       getline(infile, line);
       if (infile.fail()) break;
-      processLine(errorConstants, line);
+      processLine(errorConstants, line, re);
     }
   }
+  saveToCache(errorConstants, stamps);
 }
@@ -3,6 +3,8 @@
  * -----------------------------
  * Defines a single routine that builds of a map of errno status codes (e.g. 2) to
  * their more familiar #define constants (expressed as strings, e.g. "ENOENT").
+ * The table is cached in a small binary file so the headers are only parsed again
+ * once one of them changes.
  */
  
 #pragma once
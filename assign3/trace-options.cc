@@ -11,11 +11,64 @@ using namespace std;
 
 static const string kSimpleFlag = "--simple";
 static const string kRebuildFlag = "--rebuild";
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException) {  
+static const string kStatsFlag = "--stats";
+static const string kStringLimitFlag = "--string-limit=";
+static const string kOnlyFlag = "--only=";
+static const string kSummaryFlag = "--summary";
+static const string kFollowFlag = "-f";
+static const string kFollowLongFlag = "--follow-forks";
+static const string kOutputFlag = "-o";
+static const string kOutputLongFlag = "--output=";
+static const string kLineBufferedFlag = "--line-buffered";
+
+static size_t parseCount(const char *progname, const string& flag, const string& value) throw (TraceException) {
+  size_t endpos = 0;
+  unsigned long count = 0;
+  try {
+    count = stoul(value, &endpos);
+  } catch (const exception& e) {
+    endpos = 0;
+  }
+  if (value.empty() || endpos != value.size() || value[0] == '-')
+    throw TraceException(string(progname) + ": Expected a nonnegative number (" + flag + value + " )");
+  return count;
+}
+
+static vector<string> parseNames(const char *progname, const string& flag, const string& value) throw (TraceException) {
+  vector<string> names;
+  size_t start = 0;
+  while (true) {
+    size_t comma = value.find(',', start);
+    string name = value.substr(start, comma == string::npos ? string::npos : comma - start);
+    if (name.empty())
+      throw TraceException(string(progname) + ": Expected a comma-separated list of system call names (" + flag + value + " )");
+    names.push_back(name);
+    if (comma == string::npos) break;
+    start = comma + 1;
+  }
+  return names;
+}
+
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException) {  
   size_t numFlags = 0;
-  for (int i = 1; argv[i] != NULL && startsWith(argv[i], "--"); i++) {
-    if (argv[i] == kSimpleFlag) simple = true;
-    else if (argv[i] == kRebuildFlag) rebuild = true;
+  for (int i = 1; argv[i] != NULL && startsWith(argv[i], "-"); i++) {
+    string flag = argv[i];
+    if (flag == kSimpleFlag) options.simple = true;
+    else if (flag == kRebuildFlag) options.rebuild = true;
+    else if (flag == kStatsFlag) options.stats = true;
+    else if (flag == kSummaryFlag) options.summary = true;
+    else if (flag == kFollowFlag || flag == kFollowLongFlag) options.follow = true;
+    else if (flag == kLineBufferedFlag) options.lineBuffered = true;
+    else if (startsWith(flag, kOutputLongFlag)) options.outputFile = flag.substr(kOutputLongFlag.size());
+    else if (flag == kOutputFlag) {
+      if (argv[i + 1] == NULL) throw TraceException(string(argv[0]) + ": Expected a file name after " + kOutputFlag);
+      options.outputFile = argv[++i];
+      numFlags++;
+    }
+    else if (startsWith(flag, kStringLimitFlag))
+      options.maxStringLength = parseCount(argv[0], kStringLimitFlag, flag.substr(kStringLimitFlag.size()));
+    else if (startsWith(flag, kOnlyFlag))
+      options.onlySystemCalls = parseNames(argv[0], kOnlyFlag, flag.substr(kOnlyFlag.size()));
     else throw TraceException(string(argv[0]) + ": Unrecognized flag (" + argv[i] + " )");
     numFlags++;
   }
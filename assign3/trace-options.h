@@ -4,15 +4,49 @@
  * Exports a single function that knows how to process the command line invoking
  * trace.  The command line typically looks like the invocation of another executable, e.g.
  * something like "find /usr/include/ -name *.h -print" preceded by "trace", e.g. 
- * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed one or two
- * flags, --simple and/or --rebuild.  The first one coaches trace to output a very simplified
- * version of trace, whereas the second one instructs trace to rebuild all of the prototypes
- * from scratch instead of relying on a cached file.
+ * "trace find /usr/include/ -name *.h -print".  However, trace itself can be fed a few
+ * flags of its own, all of which are collected into a traceOptions record (see below).
  *
  * If the command line is malformed (e.g. bogus flags, etc), then a TraceException is thrown.
  */
 
 #pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
 #include "trace-exception.h"
 
-size_t processCommandLineFlags(bool& simple, bool& rebuild, char *argv[]) throw (TraceException);
+/**
+ * Type: traceOptions
+ * ------------------
+ * Bundles the settings trace's own flags can change.
+ *
+ *   simple (--simple): print system call numbers and raw return values only
+ *   rebuild (--rebuild): rebuild all of the prototypes from scratch instead of relying on a cached file
+ *   stats (--stats): report how many system calls were traced per second once the traced program exits
+ *   maxStringLength (--string-limit=<n>): print at most n characters of any string argument,
+ *                   followed by ... if the string was longer (0, the default, means no limit)
+ *   onlySystemCalls (--only=<name>,<name>,...): trace just the named system calls, and let all
+ *                   others run without stopping the traced program at all
+ *   summary (--summary): rather than print each system call, print a table of counts, errors, and
+ *                   times per system call once the traced program exits
+ *   follow (-f or --follow-forks): also trace every process and thread the traced program
+ *                   creates, prefixing each line with the id of the thread that made the call
+ *   outputFile (-o <file> or --output=<file>): write the trace to the named file instead of stdout.
+ *                   Output to a file is buffered and written by a background thread (see trace-output.h)
+ *   lineBuffered (--line-buffered): write the trace as it's produced even when it's going to a
+ *                   file, e.g. so it can be followed with tail -f
+ */
+struct traceOptions {
+  bool simple = false;
+  bool rebuild = false;
+  bool stats = false;
+  size_t maxStringLength = 0;
+  std::vector<std::string> onlySystemCalls;
+  bool summary = false;
+  bool follow = false;
+  std::string outputFile;
+  bool lineBuffered = false;
+};
+
+size_t processCommandLineFlags(traceOptions& options, char *argv[]) throw (TraceException);
@@ -0,0 +1,131 @@
+/**
+ * File: trace-output.cc
+ * ---------------------
+ * Presents the implementation of the outputWriter class exported by trace-output.h.
+ */
+
+#include "trace-output.h"
+#include <unistd.h>
+#include <errno.h>
+using namespace std;
+
+const chrono::milliseconds outputWriter::kMaxDelay(200);
+
+outputWriter::outputWriter(int fd, bool lineFlushed) :
+  fd(fd), lineFlushed(lineFlushed), closed(false), failed(false), error(0),
+  lastHandOff(chrono::steady_clock::now()), done(false) {
+  if (lineFlushed) {
+    current.resize(BUFSIZ);
+  } else {
+    current.resize(kBufferSize);
+    for (size_t i = 1; i < kNumBuffers; i++) available.push_back(vector<char>(kBufferSize));
+    writer = thread([this] { writeBuffers(); });
+  }
+  startBuffer(current);
+}
+
+outputWriter::~outputWriter() {
+  close();
+}
+
+void outputWriter::startBuffer(vector<char>& buffer) {
+  setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+bool outputWriter::writeAll(const char *data, size_t length) {
+  while (length > 0) {
+    ssize_t count = write(fd, data, length);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) {
+      // a write that wrote nothing leaves errno alone, so there's nothing better to report
+      if (error == 0) error = count == -1 ? errno : EIO;
+      return false;
+    }
+    data += count;
+    length -= count;
+  }
+  return true;
+}
+
+/**
+ * Queues up the current buffer for the background thread (trimmed down to what's
+ * actually been written to it) and starts filling a free one, waiting for the
+ * background thread to free one up if need be.
+ */
+void outputWriter::handOff() {
+  current.resize(pptr() - pbase());
+  unique_lock<mutex> ul(m);
+  full.push_back(move(current));
+  cv.notify_all();
+  cv.wait(ul, [this] { return !available.empty(); });
+  current = move(available.back());
+  available.pop_back();
+  ul.unlock();
+  current.resize(kBufferSize);
+  startBuffer(current);
+  lastHandOff = chrono::steady_clock::now();
+}
+
+/**
+ * Runs in the background thread, writing out full buffers in the order they
+ * were handed off until close says there won't be any more.
+ */
+void outputWriter::writeBuffers() {
+  unique_lock<mutex> ul(m);
+  while (true) {
+    cv.wait(ul, [this] { return !full.empty() || done; });
+    if (full.empty()) break;
+    vector<char> buffer = move(full.front());
+    full.pop_front();
+    ul.unlock();
+    bool written = writeAll(buffer.data(), buffer.size());
+    ul.lock();
+    if (!written) failed = true;
+    available.push_back(move(buffer));
+    cv.notify_all();
+  }
+}
+
+outputWriter::int_type outputWriter::overflow(int_type ch) {
+  if (closed) return traits_type::eof();
+  if (lineFlushed) {
+    if (!writeAll(pbase(), pptr() - pbase())) failed = true;
+    startBuffer(current);
+  } else {
+    handOff();
+  }
+  if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int outputWriter::sync() {
+  if (closed || pptr() == pbase()) return 0;
+  if (lineFlushed) {
+    if (!writeAll(pbase(), pptr() - pbase())) failed = true;
+    startBuffer(current);
+  } else if (chrono::steady_clock::now() - lastHandOff >= kMaxDelay) {
+    handOff();
+  }
+  return 0;
+}
+
+bool outputWriter::close() {
+  if (closed) return !failed;
+  if (lineFlushed) {
+    sync();
+  } else {
+    if (pptr() != pbase()) handOff();
+    {
+      lock_guard<mutex> lg(m);
+      done = true;
+      cv.notify_all();
+    }
+    writer.join();
+  }
+  closed = true;
+  setp(NULL, NULL);
+  return !failed;
+}
@@ -0,0 +1,84 @@
+/**
+ * File: trace-output.h
+ * --------------------
+ * Exports the outputWriter class, the stream buffer everything trace prints about
+ * the traced program goes through.  Every system call stops the traced program until
+ * trace has printed it, so trace shouldn't spend that time blocked in its own write
+ * system calls.
+ *
+ * An outputWriter either works line by line, writing whatever's accumulated whenever
+ * its stream is flushed (which is what trace has always done, and what's wanted when
+ * someone is watching), or it buffers.  A buffering outputWriter collects output into
+ * large buffers and hands each one off to a background thread that writes it, so
+ * the tracer only ever copies bytes.  A buffer is handed off once it fills, or when
+ * the stream is flushed and kMaxDelay has passed since the last handoff.  Nothing
+ * checks the clock in between, so output only moves at the next system call stop:
+ * whatever's buffered while the traced program is quiet stays put until it makes
+ * another system call (or exits).
+ */
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+class outputWriter: public std::streambuf {
+ public:
+  outputWriter(int fd, bool lineFlushed);
+  ~outputWriter();
+
+  /**
+   * Method: close
+   * -------------
+   * Writes out everything still buffered and waits for the background thread to finish,
+   * returning false if any write failed.  It needs to be called explicitly by anyone
+   * who's about to call exit, since exit doesn't destroy local variables.
+   */
+  bool close();
+
+  /**
+   * Method: getError
+   * ----------------
+   * Returns the errno of the first write that failed, or 0 if none has.  The
+   * writes may have happened on the background thread, whose errno is its own,
+   * so this is what to report once close returns false.
+   */
+  int getError() const { return error; }
+
+ protected:
+  int_type overflow(int_type ch);
+  int sync();
+
+ private:
+  static const size_t kBufferSize = 1 << 20;
+  static const size_t kNumBuffers = 4;
+  static const std::chrono::milliseconds kMaxDelay;
+
+  void startBuffer(std::vector<char>& buffer);
+  bool writeAll(const char *data, size_t length);
+  void handOff();
+  void writeBuffers();
+
+  int fd;
+  bool lineFlushed;
+  bool closed;
+  bool failed;
+  int error;  // errno of the first failed write
+  std::vector<char> current;
+  std::chrono::steady_clock::time_point lastHandOff;
+
+  // shared with the background thread
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::vector<char>> full;  // filled buffers, oldest first
+  std::vector<std::vector<char>> available; // buffers available for filling
+  bool done;
+  std::thread writer;
+
+  outputWriter(const outputWriter& original) = delete;
+  outputWriter& operator=(const outputWriter& rhs) = delete;
+};
@@ -0,0 +1,110 @@
+/**
+ * File: trace-summary.cc
+ * ----------------------
+ * Presents the implementation of the systemCallSummary class exported by trace-summary.h.
+ */
+
+#include "trace-summary.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+using namespace std;
+
+int systemCallSummary::bucketFor(uint64_t nanoseconds) {
+  if (nanoseconds < (uint64_t) kSubBuckets) return nanoseconds;
+  int exponent = 63 - __builtin_clzll(nanoseconds); // position of the highest set bit
+  int subBucket = (nanoseconds >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+  return (exponent - kSubBucketBits + 1) * kSubBuckets + subBucket;
+}
+
+uint64_t systemCallSummary::bucketMidpoint(int bucket) {
+  if (bucket < kSubBuckets) return bucket;
+  int exponent = bucket / kSubBuckets + kSubBucketBits - 1;
+  int shift = exponent - kSubBucketBits;
+  uint64_t low = (uint64_t) (kSubBuckets + bucket % kSubBuckets) << shift;
+  return low + ((1ULL << shift) >> 1);
+}
+
+systemCallSummary::entry& systemCallSummary::lookup(long systemcallno) {
+  if (systemcallno < 0 || systemcallno >= kMaxIndexedNumber) return otherEntries[systemcallno];
+  if ((size_t) systemcallno >= entries.size()) entries.resize(systemcallno + 1);
+  return entries[systemcallno];
+}
+
+void systemCallSummary::record(long systemcallno, bool failed, uint64_t nanoseconds) {
+  entry& e = lookup(systemcallno);
+  if (e.histogram.empty()) e.histogram.resize(kNumBuckets);
+  e.calls++;
+  if (failed) e.errors++;
+  e.timedCalls++;
+  e.total += nanoseconds;
+  e.min = std::min(e.min, nanoseconds);
+  e.max = std::max(e.max, nanoseconds);
+  e.histogram[bucketFor(nanoseconds)]++;
+}
+
+void systemCallSummary::recordNoReturn(long systemcallno) {
+  lookup(systemcallno).calls++;
+}
+
+/**
+ * Estimates the time below which the specified fraction of the timed calls fall, as
+ * the midpoint of the bucket holding that call (kept within the observed min and max).
+ */
+uint64_t systemCallSummary::percentile(const entry& e, double fraction) {
+  if (e.timedCalls == 0) return 0;
+  uint64_t rank = max<uint64_t>(1, ceil(fraction * e.timedCalls));
+  uint64_t seen = 0;
+  for (int bucket = 0; bucket < kNumBuckets; bucket++) {
+    seen += e.histogram[bucket];
+    if (seen >= rank) return std::min(e.max, std::max(e.min, bucketMidpoint(bucket)));
+  }
+  return e.max;
+}
+
+static double microseconds(uint64_t nanoseconds) {
+  return nanoseconds / 1000.0;
+}
+
+void systemCallSummary::print(ostream& os, const systemCallInfo *systemCalls, size_t numSystemCalls) const {
+  vector<pair<long, const entry *>> rows;
+  uint64_t calls = 0, errors = 0, total = 0;
+  for (size_t systemcallno = 0; systemcallno < entries.size(); systemcallno++) {
+    if (entries[systemcallno].calls > 0) rows.push_back(make_pair(systemcallno, &entries[systemcallno]));
+  }
+  for (const auto& p: otherEntries) rows.push_back(make_pair(p.first, &p.second));
+  for (const auto& row: rows) {
+    calls += row.second->calls;
+    errors += row.second->errors;
+    total += row.second->total;
+  }
+  stable_sort(rows.begin(), rows.end(), [](const pair<long, const entry *>& a, const pair<long, const entry *>& b) {
+    return a.second->total > b.second->total;
+  });
+
+  ios::fmtflags flags = os.flags();
+  os << fixed;
+  os << setw(7) << "% time" << setw(12) << "seconds" << setw(10) << "calls" << setw(9) << "errors"
+     << setw(11) << "min(us)" << setw(11) << "p50(us)" << setw(11) << "p99(us)" << setw(11) << "max(us)"
+     << "  syscall" << endl;
+  os << string(7 + 12 + 10 + 9 + 4 * 11 + 2 + 16, '-') << endl;
+  for (const auto& row: rows) {
+    const entry& e = *row.second;
+    bool named = row.first >= 0 && (size_t) row.first < numSystemCalls && systemCalls[row.first].name != NULL;
+    string name = named ? systemCalls[row.first].name : "syscall_" + to_string(row.first);
+    os << setprecision(2) << setw(7) << (total == 0 ? 0.0 : 100.0 * e.total / total)
+       << setprecision(6) << setw(12) << e.total / 1e9
+       << setw(10) << e.calls << setw(9) << e.errors << setprecision(1);
+    if (e.timedCalls == 0) {
+      os << setw(11) << "-" << setw(11) << "-" << setw(11) << "-" << setw(11) << "-";
+    } else {
+      os << setw(11) << microseconds(e.min) << setw(11) << microseconds(percentile(e, 0.5))
+         << setw(11) << microseconds(percentile(e, 0.99)) << setw(11) << microseconds(e.max);
+    }
+    os << "  " << name << endl;
+  }
+  os << string(7 + 12 + 10 + 9 + 4 * 11 + 2 + 16, '-') << endl;
+  os << setprecision(2) << setw(7) << 100.0 << setprecision(6) << setw(12) << total / 1e9
+     << setw(10) << calls << setw(9) << errors << setw(4 * 11) << "" << "  total" << endl;
+  os.flags(flags);
+}
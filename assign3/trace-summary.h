@@ -0,0 +1,83 @@
+/**
+ * File: trace-summary.h
+ * ---------------------
+ * Exports the systemCallSummary class, which trace's --summary mode uses to
+ * aggregate every system call the traced program makes into one table, in
+ * the spirit of strace -c.  For each system call it tracks how often it was
+ * made and how often it failed, along with the total, minimum, and maximum
+ * time spent in it and a histogram from which the median and 99th percentile
+ * times are estimated.
+ *
+ * Times are wall-clock times from the stop at a system call's entry to the
+ * stop at its exit, so they include whatever time the kernel spent switching
+ * to and from trace between the two.
+ */
+
+#pragma once
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "trace-system-calls.h"
+
+class systemCallSummary {
+ public:
+
+  /**
+   * Method: record
+   * --------------
+   * Adds one completed call of the specified system call, which returned
+   * an error if failed is true and took the specified number of nanoseconds.
+   */
+  void record(long systemcallno, bool failed, uint64_t nanoseconds);
+
+  /**
+   * Method: recordNoReturn
+   * ----------------------
+   * Adds one call of the specified system call that never returned (e.g. exit_group),
+   * which counts as a call but contributes nothing to the times.
+   */
+  void recordNoReturn(long systemcallno);
+
+  /**
+   * Method: print
+   * -------------
+   * Prints the table, one line per system call in decreasing order of total
+   * time, followed by a line of totals.  Names are taken from the supplied table,
+   * which is indexed by system call number (see trace-system-calls.h).
+   */
+  void print(std::ostream& os, const systemCallInfo *systemCalls, size_t numSystemCalls) const;
+
+ private:
+  /**
+   * Histogram buckets are logarithmic: below 2^kSubBucketBits nanoseconds each value
+   * has a bucket of its own, and every power of two above that is split into
+   * 2^kSubBucketBits equal buckets, so a bucket's width is never more than 1/8th of
+   * the values it holds.  That covers every uint64_t in 496 buckets.
+   */
+  static const int kSubBucketBits = 3;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kNumBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+  static int bucketFor(uint64_t nanoseconds);
+  static uint64_t bucketMidpoint(int bucket);
+
+  struct entry {
+    uint64_t calls = 0;
+    uint64_t errors = 0;
+    uint64_t timedCalls = 0;
+    uint64_t total = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+    std::vector<uint32_t> histogram;
+  };
+
+  static uint64_t percentile(const entry& e, double fraction);
+  entry& lookup(long systemcallno);
+
+  // indexed by system call number, save for the (never expected) numbers that are
+  // negative or absurdly large, which are kept in the map instead
+  static const long kMaxIndexedNumber = 4096;
+  std::vector<entry> entries;
+  std::map<long, entry> otherEntries;
+};
@@ -6,6 +6,7 @@
  */
  
 #include "trace-system-calls.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <regex>
@@ -380,3 +381,26 @@ void compileSystemCallData(map<int, string>& systemCallNumbers,
   collectSystemCallNumbers(systemCallNumbers, systemCallNames);
   collectSystemCallSignatures(systemCallSignatures, systemCallNames, rebuild);
 }
+
+/**
+ * Function: buildSystemCallTable
+ * ------------------------------
+ * Straightforward, save for the fact that there are gaps in the numbering, and those
+ * entries are left with a NULL name.
+ */
+vector<systemCallInfo> buildSystemCallTable(const map<int, string>& systemCallNumbers,
+                                            const map<string, systemCallSignature>& systemCallSignatures) {
+  vector<systemCallInfo> table;
+  if (systemCallNumbers.empty()) return table;
+  table.resize(systemCallNumbers.rbegin()->first + 1, systemCallInfo{NULL, -1, {}});
+  for (const auto& p: systemCallNumbers) {
+    if (p.first < 0) continue;
+    systemCallInfo& info = table[p.first];
+    info.name = p.second.c_str();
+    auto found = systemCallSignatures.find(p.second);
+    if (found == systemCallSignatures.end() || found->second.size() > 6) continue;
+    info.numParameters = found->second.size();
+    copy(found->second.begin(), found->second.end(), info.parameters);
+  }
+  return table;
+}
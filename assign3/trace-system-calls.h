@@ -82,3 +82,29 @@ typedef std::vector<scParamType> systemCallSignature;
 void compileSystemCallData(std::map<int, std::string>& systemCallNumbers,
                            std::map<std::string, int>& systemCallNames,
                            std::map<std::string, systemCallSignature>& systemCallSignatures, bool rebuild);
+
+/**
+ * Type: systemCallInfo
+ * --------------------
+ * Everything trace needs to know about a single system call number, laid out so that
+ * a whole table of them can be indexed by system call number.  name is NULL if no
+ * system call has the number, and numParameters is -1 if the signature isn't known.
+ */
+struct systemCallInfo {
+  const char *name;
+  int numParameters;
+  scParamType parameters[6];
+};
+
+/**
+ * Function: buildSystemCallTable
+ * ------------------------------
+ * Flattens the maps populated by compileSystemCallData into a table indexed by system call
+ * number, with an entry for every number up through the largest one.  The names in the
+ * table point into systemCallNumbers, so the table is only good for as long as that map is.
+ *
+ * trace doesn't usually call compileSystemCallData at all: trace-table-generator runs this
+ * at build time and writes the table out as the constexpr array in trace-system-call-table.h.
+ */
+std::vector<systemCallInfo> buildSystemCallTable(const std::map<int, std::string>& systemCallNumbers,
+                                                 const std::map<std::string, systemCallSignature>& systemCallSignatures);
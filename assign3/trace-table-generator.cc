@@ -0,0 +1,62 @@
+/**
+ * File: trace-table-generator.cc
+ * ------------------------------
+ * Build-time helper that writes the system call table trace compiles in, so that
+ * trace itself never has to parse unistd_64.h or the cached signatures (let alone
+ * the kernel source tree) just to start up.  The Makefile runs it as
+ *
+ *    ./trace-table-generator trace-system-call-table.h
+ *
+ * whenever the generator, the cached signatures, or unistd_64.h change.  It writes to a
+ * named file rather than to stdout because compileSystemCallData prints progress
+ * messages of its own whenever the signature cache has to be rebuilt.
+ */
+
+#include "trace-system-calls.h"
+#include <fstream>
+#include <iostream>
+using namespace std;
+
+static const int kWrongArgumentCount = 1;
+static const int kOutputFailed = 2;
+
+static void writeTable(ostream& os, const vector<systemCallInfo>& table) {
+  os << "/**" << endl;
+  os << " * File: trace-system-call-table.h" << endl;
+  os << " * -------------------------------" << endl;
+  os << " * Generated by trace-table-generator; do not edit." << endl;
+  os << " */" << endl << endl;
+  os << "#pragma once" << endl;
+  os << "#include \"trace-system-calls.h\"" << endl << endl;
+  os << "constexpr size_t kNumSystemCalls = " << table.size() << ";" << endl;
+  os << "constexpr systemCallInfo kSystemCallTable[kNumSystemCalls] = {" << endl;
+  for (size_t number = 0; number < table.size(); number++) {
+    const systemCallInfo& info = table[number];
+    os << "  /* " << number << " */ {";
+    if (info.name == NULL) os << "NULL"; else os << "\"" << info.name << "\"";
+    os << ", " << info.numParameters << ", {";
+    for (int i = 0; i < info.numParameters; i++) os << (i == 0 ? "" : ", ") << info.parameters[i];
+    os << "}}," << endl;
+  }
+  os << "};" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    cerr << "Usage: " << argv[0] << " <header-file>" << endl;
+    return kWrongArgumentCount;
+  }
+
+  map<int, string> systemCallNumbers;
+  map<string, int> systemCallNames;
+  map<string, systemCallSignature> systemCallSignatures;
+  compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, /* rebuild = */ false);
+  ofstream outfile(argv[1]);
+  writeTable(outfile, buildSystemCallTable(systemCallNumbers, systemCallSignatures));
+  outfile.close();
+  if (outfile.fail()) {
+    cerr << "Failed to write \"" << argv[1] << "\"." << endl;
+    return kOutputFailed;
+  }
+  return 0;
+}
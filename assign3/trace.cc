@@ -9,18 +9,32 @@
  *    + the values of all of its arguments, and
  *    + the system calls return value
  */
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <set>
 #include <unistd.h> // for fork, execvp
-#include <string.h> // for memchr, strerror
+#include <string.h> // for memchr, memcpy, strerror
+#include <errno.h>
+#include <sys/uio.h> // for process_vm_readv
+#include <sys/prctl.h>
+#include <stddef.h> // for offsetof
+#include <linux/audit.h> // for AUDIT_ARCH_X86_64
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 #include <sys/ptrace.h>
-#include <sys/reg.h>
+#include <sys/user.h> // for struct user_regs_struct
 #include <sys/wait.h>
+#include <fcntl.h>
 #include "trace-options.h"
 #include "trace-error-constants.h"
 #include "trace-system-calls.h"
+#include "trace-system-call-table.h"
+#include "trace-summary.h"
+#include "trace-output.h"
 #include "trace-exception.h"
 using namespace std;
 
@@ -28,200 +42,551 @@ map<int, string> systemCallNumbers;
 map<string, int> systemCallNames;
 map<string, systemCallSignature> systemCallSignatures;
 map<int, string> errorConstants;
-int registers[] = {RDI, RSI, RDX, R10, R8, R9};
 set<string> specialcommands {"brk", "sbrk", "mmap"};
 
-static string handleString(pid_t pid, int index)
+/**
+ * The tables consulted at every stop, so that decoding a system call is a matter of
+ * indexing rather than searching.  systemCalls is indexed by system call number, and
+ * is the kSystemCallTable compiled into trace unless --rebuild is used, in which case
+ * it's rebuilt from the maps above.  errorNames is indexed by errno value, and
+ * returnsAddress flags the system calls in specialcommands, whose return values are
+ * addresses rather than integers.
+ */
+static const systemCallInfo *systemCalls = kSystemCallTable;
+static size_t systemCallTableSize = kNumSystemCalls;
+static vector<systemCallInfo> rebuiltSystemCalls;
+static vector<string> errorNames;
+static vector<bool> returnsAddress;
+
+static const systemCallInfo *lookupSystemCall(long systemcallno)
 {
-  long baseaddr = ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
-  string str;
+  if (systemcallno < 0 || (size_t) systemcallno >= systemCallTableSize) return NULL;
+  if (systemCalls[systemcallno].name == NULL) return NULL;
+  return &systemCalls[systemcallno];
+}
+
+static string systemCallName(long systemcallno)
+{
+  const systemCallInfo *info = lookupSystemCall(systemcallno);
+  return info != NULL ? info->name : "syscall_" + to_string(systemcallno);
+}
+
+/**
+ * The registers holding a system call's first through sixth arguments, in order.
+ * Every stop fetches all of the tracee's registers with a single PTRACE_GETREGS,
+ * and the arguments are pulled out of that snapshot rather than peeked one at a time.
+ */
+static unsigned long long user_regs_struct::*const kArgumentRegisters[] = {
+  &user_regs_struct::rdi, &user_regs_struct::rsi, &user_regs_struct::rdx,
+  &user_regs_struct::r10, &user_regs_struct::r8, &user_regs_struct::r9
+};
+
+static long argumentValue(const user_regs_struct& regs, int index)
+{
+  return regs.*kArgumentRegisters[index];
+}
+
+/**
+ * Strings are pulled out of the tracee at most a page at a time, and never across
+ * a page boundary, since the page after the one holding a string's terminating
+ * '\0' may well not be mapped.  Pages are at least 4K on x86_64.
+ */
+static const size_t kPageSize = 4096;
+
+/**
+ * Copies up to len bytes at addr in the tracee's address space into buf, and
+ * returns the number of bytes actually copied, which falls short of len only if
+ * some of the memory couldn't be read.  process_vm_readv does the whole copy in
+ * one system call, but it can be disabled where ptrace isn't, so we fall back on
+ * peeking one word at a time when it fails.
+ */
+static size_t readTraceeMemory(pid_t pid, long addr, char *buf, size_t len)
+{
+  struct iovec local = {buf, len};
+  struct iovec remote = {reinterpret_cast<void *>(addr), len};
+  ssize_t count = process_vm_readv(pid, &local, 1, &remote, 1, 0);
+  if (count > 0) return count;
+
   size_t numBytesRead = 0;
-  bool unseen = true;
-  while(true)
+  while (numBytesRead < len)
   {
-    long outlong = ptrace(PTRACE_PEEKDATA, pid, baseaddr + numBytesRead);
-    void *outvp = reinterpret_cast<void *>(&outlong);
-    char *out = (char *)outvp;
-    size_t outlen = sizeof(long);
-    for (int i = 0; i < 8; ++i)
+    errno = 0;
+    long word = ptrace(PTRACE_PEEKDATA, pid, addr + numBytesRead);
+    if (errno != 0) break;
+    size_t numBytes = min(sizeof(long), len - numBytesRead);
+    memcpy(buf + numBytesRead, &word, numBytes);
+    numBytesRead += numBytes;
+  }
+  return numBytesRead;
+}
+
+/**
+ * Reads the C string at baseaddr out of the tracee.  If maxLength is nonzero, only
+ * its first maxLength characters are returned, and truncated is set to true if
+ * there were more.
+ */
+static string handleString(pid_t pid, long baseaddr, size_t maxLength, bool& truncated)
+{
+  string str;
+  char chunk[kPageSize];
+  long addr = baseaddr;
+  truncated = false;
+  while (true)
+  {
+    size_t len = kPageSize - addr % kPageSize;
+    if (maxLength != 0)
     {
-      if(out[i] == '\0')
-      {
-        outlen = i;
-        unseen = false;
-        break;
-      }
+      len = min(len, maxLength + 1 - str.size()); // one extra to learn whether there's more
     }
-    str.append(out, outlen);
-    numBytesRead += outlen;
-    if (!unseen)
+    size_t numBytesRead = readTraceeMemory(pid, addr, chunk, len);
+    const char *end = static_cast<const char *>(memchr(chunk, '\0', numBytesRead));
+    if (end != NULL)
     {
+      str.append(chunk, end - chunk);
       break;
     }
+    str.append(chunk, numBytesRead);
+    if (numBytesRead < len) break; // the rest isn't readable, so print what we have
+    if (maxLength != 0 && str.size() > maxLength) break;
+    addr += numBytesRead;
+  }
+  if (maxLength != 0 && str.size() > maxLength)
+  {
+    str.resize(maxLength);
+    truncated = true;
   }
   return str;
 }
 
-static void outputFull(long systemcallno, string command, pid_t pid)
+static void outputFull(ostream& os, const user_regs_struct& regs, long systemcallno, pid_t pid, size_t maxStringLength)
 {
-  vector<scParamType> vec;
-  auto v = systemCallSignatures.find(command);
-  if (v != systemCallSignatures.end())
+  const systemCallInfo *info = lookupSystemCall(systemcallno);
+  if (info != NULL && info->numParameters >= 0)
   {
-    vec = v->second;
-    int index = 0;
-    int len = vec.size();
-    cout << command << "(";
-    for (auto &elem : vec)
+    int len = info->numParameters;
+    os << info->name << "(";
+    for (int index = 0; index < len; index++)
     {
+      scParamType elem = info->parameters[index];
       if (elem == SYSCALL_STRING)
       {
-        string outputstr = handleString(pid, index);
-        cout << "\"" << outputstr << "\""; 
+        bool truncated;
+        string outputstr = handleString(pid, argumentValue(regs, index), maxStringLength, truncated);
+        os << "\"" << outputstr << "\"";
+        if (truncated)
+        {
+          os << "...";
+        }
       }
       if (elem == SYSCALL_POINTER)
       {
-        long outlong;
-        outlong = ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
+        long outlong = argumentValue(regs, index);
         void *outptr = reinterpret_cast<void *>(outlong);
         if (outptr == 0)
         {
-          cout << "NULL";
+          os << "NULL";
         }
         else
         {
-          cout << outptr;
+          os << outptr;
         }
       }
       if (elem == SYSCALL_INTEGER)
       {
-        long outlong;
-        outlong = ptrace(PTRACE_PEEKUSER, pid, registers[index] * sizeof(long));
-        cout << (int)outlong;
+        long outlong = argumentValue(regs, index);
+        os << (int)outlong;
       }
       if (index != (len - 1))
       {
-        cout << ", ";
+        os << ", ";
       }
-      index++;
     }
-    cout << ") = ";
-    cout.flush();
+    os << ") = ";
+    os.flush();
   }
   else
   {
-    cout << command << "(<signature-information-missing>) = ";
+    os << systemCallName(systemcallno) << "(<signature-information-missing>) = ";
   }
 }
 
-static void outputSimple(long systemcallno)
+static void outputSimple(ostream& os, long systemcallno)
 {
-  cout << "syscall(" << systemcallno << ") = ";
-  cout.flush();
+  os << "syscall(" << systemcallno << ") = ";
+  os.flush();
 }
 
-static void outputSimpleReturn(long returnvalue)
+static void outputSimpleReturn(ostream& os, long returnvalue)
 {
-  cout << (int)returnvalue << endl;
+  os << (int)returnvalue << endl;
 }
 
-static void outputFullReturn(long returnvalue, string command)
+static void outputFullReturn(ostream& os, long returnvalue, long systemcallno)
 {
-  if(specialcommands.find(command) != specialcommands.end())
+  if(systemcallno >= 0 && (size_t) systemcallno < returnsAddress.size() && returnsAddress[systemcallno])
   {
     void *outvp = reinterpret_cast<void *>(returnvalue);
-    cout << outvp;
+    os << outvp;
   }
   else
   {
     if (returnvalue < 0)
     {
-      cout << "-1 " << errorConstants[abs(returnvalue)] << " (" << strerror(abs(returnvalue)) << ")";
+      size_t errnum = abs(returnvalue);
+      os << "-1 " << (errnum < errorNames.size() ? errorNames[errnum] : "") << " (" << strerror(errnum) << ")";
     }
     else
     {
       //new: returnvalue
-      cout << (int)returnvalue;
+      os << (int)returnvalue;
     }
   }
-  cout << endl;
-  cout.flush();
+  os << endl;
+  os.flush();
+}
+
+/**
+ * Prints how many system calls were traced and how quickly, so the cost of
+ * tracing can be compared across workloads and across versions of trace.
+ */
+static void outputStats(size_t numSystemCalls, chrono::steady_clock::time_point start)
+{
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  cerr << endl << "Traced " << numSystemCalls << " system calls in " << elapsed.count() << " seconds";
+  if (elapsed.count() > 0)
+  {
+    cerr << " (" << (long)(numSystemCalls / elapsed.count()) << " system calls per second)";
+  }
+  cerr << "." << endl;
+}
+
+/**
+ * Builds the seccomp-bpf program installed in the traced process when --only is used.
+ * It hands just the listed system calls to the tracer (SECCOMP_RET_TRACE) and lets
+ * everything else run without a stop.  System calls made through some other ABI
+ * (e.g. 32-bit int 0x80) have different numbers, so they're let through as well.
+ */
+static vector<sock_filter> buildSystemCallFilter(const vector<int>& selected)
+{
+  vector<sock_filter> filter = {
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0),
+    BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr))
+  };
+  for (int systemcallno : selected)
+  {
+    filter.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (unsigned int) systemcallno, 0, 1));
+    filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE));
+  }
+  filter.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+  return filter;
+}
+
+/**
+ * Type: tracee
+ * ------------
+ * Everything trace needs to remember about one traced thread between stops.  Entry
+ * and exit stops for a thread alternate, but with -f the stops of different
+ * threads interleave arbitrarily, so each keeps its own record of the system call
+ * it's in the middle of (if any).  With -f each line is also assembled in pending
+ * and printed whole once the system call returns, so lines from different threads
+ * never run together.
+ */
+struct tracee {
+  bool inSystemCall = false;
+  bool expectingStop = false; // newly forked or cloned, and its initial SIGSTOP hasn't arrived yet
+  long systemcallno = -1;
+  chrono::steady_clock::time_point entered;
+  ostringstream pending;
+};
+
+static const int kSeccompStop = SIGTRAP | (PTRACE_EVENT_SECCOMP << 8);
+
+/**
+ * Returns the signal a signal-delivery-stop should pass along to the tracee once
+ * it's resumed.  Group-stops look the same from waitpid, but have no siginfo, and
+ * passing their signal along would only stop the tracee all over again.
+ */
+static int pendingSignal(pid_t tid, int status)
+{
+  siginfo_t info;
+  if (ptrace(PTRACE_GETSIGINFO, tid, 0, &info) == -1) return 0;
+  return WSTOPSIG(status);
 }
 
-static void RunTrace(int numFlags, bool simple, bool rebuild, char *argv[])
+static void RunTrace(int numFlags, const traceOptions& options, const vector<int>& selected, int outputfd, char *argv[])
 {
+  auto start = chrono::steady_clock::now();
+  size_t numSystemCalls = 0;
+  systemCallSummary summary;
+  bool filtered = !selected.empty();
+  vector<sock_filter> filter;
+  if (filtered) filter = buildSystemCallFilter(selected);
   pid_t pid = fork();
   if (pid == 0)
   {
     ptrace(PTRACE_TRACEME);
     raise(SIGSTOP);
+    if (filtered)
+    {
+      // installed only once the tracer has asked for seccomp stops, since
+      // until then SECCOMP_RET_TRACE would fail the selected calls outright
+      sock_fprog program = {(unsigned short) filter.size(), filter.data()};
+      if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) == -1 ||
+          prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &program) == -1)
+      {
+        cerr << "Failed to install the system call filter: " << strerror(errno) << endl;
+        exit(1);
+      }
+    }
     execvp(argv[numFlags + 1], argv + numFlags + 1);
   }
+  // everything reported about the tracee goes through out; only a file gets
+  // buffered, since output to the terminal is usually being watched as it happens
+  outputWriter writer(outputfd, options.lineBuffered || outputfd == STDOUT_FILENO);
+  ostream out(&writer);
   waitpid(pid, NULL, 0);
-  ptrace(PTRACE_SETOPTIONS, pid, 0, PTRACE_O_TRACESYSGOOD);
-  while(true)
+  long ptraceOptions = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACEEXEC;
+  if (filtered) ptraceOptions |= PTRACE_O_TRACESECCOMP;
+  if (options.follow) ptraceOptions |= PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACECLONE;
+  ptrace(PTRACE_SETOPTIONS, pid, 0, ptraceOptions);
+
+  map<pid_t, tracee> tracees;
+  tracees[pid];
+  int exitStatus = 0;
+
+  // with a filter in place, a thread runs freely until it makes a selected call
+  auto resume = [&](pid_t tid, const tracee& t, int sig)
   {
-    string command;
-    while(true)
+    ptrace(filtered && !t.inSystemCall ? PTRACE_CONT : PTRACE_SYSCALL, tid, 0, sig);
+  };
+  resume(pid, tracees[pid], 0);
+
+  while (!tracees.empty())
+  {
+    int status;
+    pid_t tid = waitpid(-1, &status, __WALL);
+    if (tid == -1) break;
+
+    if (WIFEXITED(status) || WIFSIGNALED(status))
     {
-      int status;
-      ptrace(PTRACE_SYSCALL, pid, 0, 0);
-      waitpid(pid, &status, 0);
-      
-      if (WIFSTOPPED(status) && (WSTOPSIG(status) & 0x80))
+      auto found = tracees.find(tid);
+      if (found == tracees.end()) continue;
+      tracee& t = found->second;
+      if (t.inSystemCall)
       {
-        long systemcallno;
-        systemcallno = ptrace(PTRACE_PEEKUSER, pid, ORIG_RAX * sizeof(long));
-        command = systemCallNumbers.find(systemcallno)->second;
-        if(simple)
+        if (options.summary)
         {
-          outputSimple(systemcallno);
+          summary.recordNoReturn(t.systemcallno);
+        }
+        else if (options.follow)
+        {
+          out << "[pid " << tid << "] " << t.pending.str() << "<no return>" << endl;
         }
         else
         {
-          outputFull(systemcallno, command, pid);
+          out << "<no return>" << endl;
         }
-        break;
       }
+      if (tid == pid) exitStatus = status;
+      tracees.erase(found);
+      continue;
     }
+    if (!WIFSTOPPED(status)) continue;
 
-    while(true)
+    auto found = tracees.find(tid);
+    if (found == tracees.end())
+    {
+      // a new child or thread whose initial stop beat the fork/clone event announcing it
+      tracee& t = tracees[tid];
+      resume(tid, t, WSTOPSIG(status) == SIGSTOP ? 0 : pendingSignal(tid, status));
+      continue;
+    }
+    tracee& t = found->second;
+    ostream& os = options.follow ? static_cast<ostream&>(t.pending) : out;
+
+    int event = status >> 16;
+    if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK || event == PTRACE_EVENT_CLONE)
+    {
+      unsigned long child;
+      ptrace(PTRACE_GETEVENTMSG, tid, 0, &child);
+      if (tracees.find(child) == tracees.end()) tracees[child].expectingStop = true;
+      resume(tid, t, 0);
+    }
+    else if (event == PTRACE_EVENT_EXEC)
+    {
+      // a thread other than the leader that calls execve takes over the leader's
+      // id, and the thread that made the call never reports anything again
+      unsigned long former;
+      ptrace(PTRACE_GETEVENTMSG, tid, 0, &former);
+      if ((pid_t) former != tid && tracees.find(former) != tracees.end())
+      {
+        tracees[tid] = move(tracees[former]);
+        tracees.erase(former);
+      }
+      tracee& current = tracees[tid];
+      resume(tid, current, 0);
+    }
+    else if ((filtered && (status >> 8) == kSeccompStop) ||
+             (!filtered && WSTOPSIG(status) == (SIGTRAP | 0x80) && !t.inSystemCall))
+    {
+      user_regs_struct regs;
+      ptrace(PTRACE_GETREGS, tid, 0, &regs);
+      t.inSystemCall = true;
+      t.systemcallno = regs.orig_rax;
+      numSystemCalls++;
+      if (options.summary)
+      {
+        t.entered = chrono::steady_clock::now();
+      }
+      else if (options.simple)
+      {
+        outputSimple(os, t.systemcallno);
+      }
+      else
+      {
+        outputFull(os, regs, t.systemcallno, tid, options.maxStringLength);
+      }
+      resume(tid, t, 0);
+    }
+    else if (WSTOPSIG(status) == (SIGTRAP | 0x80) && t.inSystemCall)
     {
-      int status2;
-      ptrace(PTRACE_SYSCALL, pid, 0, 0);
-      waitpid(pid, &status2, 0);
-      if (WIFSTOPPED(status2) && (WSTOPSIG(status2) & 0x80))
+      user_regs_struct regs;
+      ptrace(PTRACE_GETREGS, tid, 0, &regs);
+      long returnvalue = regs.rax;
+      t.inSystemCall = false;
+      if (options.summary)
+      {
+        chrono::nanoseconds elapsed = chrono::steady_clock::now() - t.entered;
+        summary.record(t.systemcallno, returnvalue < 0 && returnvalue >= -4095, elapsed.count());
+      }
+      else
       {
-        long returnvalue = ptrace(PTRACE_PEEKUSER, pid, RAX * sizeof(long));
-        if (simple)
+        if (options.simple)
         {
-          outputSimpleReturn(returnvalue);
+          outputSimpleReturn(os, returnvalue);
         }
         else
         {
-          outputFullReturn(returnvalue, command);
+          outputFullReturn(os, returnvalue, t.systemcallno);
+        }
+        if (options.follow)
+        {
+          out << "[pid " << tid << "] " << t.pending.str();
+          t.pending.str("");
         }
-        break;
       }
-      if (WIFEXITED(status2))
-      {
-        cout << "<no return>" << endl << "Program exited normally with status " << WEXITSTATUS(status2);
-        cout.flush();
-        exit(0);
-      }  
+      resume(tid, t, 0);
+    }
+    else if (t.expectingStop && WSTOPSIG(status) == SIGSTOP)
+    {
+      t.expectingStop = false;
+      resume(tid, t, 0);
+    }
+    else
+    {
+      resume(tid, t, pendingSignal(tid, status));
+    }
+  }
+
+  if (options.summary)
+  {
+    summary.print(out, systemCalls, systemCallTableSize);
+  }
+  if (WIFSIGNALED(exitStatus))
+  {
+    out << "Program terminated by signal " << WTERMSIG(exitStatus) << " (" << strsignal(WTERMSIG(exitStatus)) << ")";
+  }
+  else
+  {
+    out << "Program exited normally with status " << WEXITSTATUS(exitStatus);
+  }
+  out.flush();
+  if (!writer.close())
+  {
+    cerr << "Failed to write all of the trace output: " << strerror(writer.getError()) << endl;
+  }
+  if (options.stats)
+  {
+    outputStats(numSystemCalls, start);
+  }
+  exit(0);
+}
+
+/**
+ * Translates the names passed via --only into system call numbers, returning
+ * false if any of them doesn't name a system call.
+ */
+static bool selectSystemCalls(const vector<string>& names, vector<int>& selected)
+{
+  for (const string& name : names)
+  {
+    size_t systemcallno = 0;
+    while (systemcallno < systemCallTableSize &&
+           (systemCalls[systemcallno].name == NULL || name != systemCalls[systemcallno].name))
+    {
+      systemcallno++;
+    }
+    if (systemcallno == systemCallTableSize)
+    {
+      cerr << "Unrecognized system call name (" << name << ")" << endl;
+      return false;
     }
+    selected.push_back(systemcallno);
   }
+  return true;
 }
+
+/**
+ * Populates the tables consulted at every stop (see systemCalls above).
+ */
+static void compileTables(bool rebuild)
+{
+  if (rebuild)
+  {
+    compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, rebuild);
+    rebuiltSystemCalls = buildSystemCallTable(systemCallNumbers, systemCallSignatures);
+    systemCalls = rebuiltSystemCalls.data();
+    systemCallTableSize = rebuiltSystemCalls.size();
+  }
+  returnsAddress.assign(systemCallTableSize, false);
+  for (size_t systemcallno = 0; systemcallno < systemCallTableSize; systemcallno++)
+  {
+    const char *name = systemCalls[systemcallno].name;
+    returnsAddress[systemcallno] = name != NULL && specialcommands.count(name) > 0;
+  }
+
+  compileSystemCallErrorStrings(errorConstants);
+  for (const auto& p : errorConstants)
+  {
+    if (p.first < 0) continue;
+    if ((size_t) p.first >= errorNames.size()) errorNames.resize(p.first + 1);
+    errorNames[p.first] = p.second;
+  }
+}
+
 int main(int argc, char *argv[]) {
-  bool simple = false, rebuild = false;
-  int numFlags = processCommandLineFlags(simple, rebuild, argv);
+  traceOptions options;
+  int numFlags = processCommandLineFlags(options, argv);
   if (argc - numFlags == 1) {
     cout << "Nothing to trace... exiting." << endl;
     return 0;
   }
 
-  compileSystemCallData(systemCallNumbers, systemCallNames, systemCallSignatures, rebuild);
-  compileSystemCallErrorStrings(errorConstants); 
-  RunTrace(numFlags, simple, rebuild, argv);
+  compileTables(options.rebuild);
+  vector<int> selected;
+  if (!selectSystemCalls(options.onlySystemCalls, selected)) return 1;
+  int outputfd = STDOUT_FILENO;
+  if (!options.outputFile.empty())
+  {
+    outputfd = open(options.outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (outputfd == -1)
+    {
+      cerr << "Failed to open \"" << options.outputFile << "\": " << strerror(errno) << endl;
+      return 1;
+    }
+  }
+  RunTrace(numFlags, options, selected, outputfd, argv);
   return 0;
 }